@@ -1,142 +1,113 @@
-int sprite_frames[10][11*11] = {
+// Generated by sprites/make_frames.py from the PNGs in sprites/. Do not edit.
+
+/**
+ * An 11x11 sprite: a palette of up to 16 RGB565 colours, and a 4-bit palette
+ * index for each pixel in row-major order, two to a byte, low nibble first.
+ */
+typedef struct {
+    unsigned short palette[16];
+    unsigned char pixels[(11*11 + 1) / 2];
+} Sprite;
+
+static const Sprite sprite_frames[10] = {
 //0 apple tree
 {
-0x0, 0x0, 0xcddc39, 0xf44336, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0x0, 0x0, 
-0x0, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xf44336, 0xcddc39, 0xcddc39, 0x0, 
-0x0, 0xf44336, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0x0, 
-0x0, 0x0, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xf44336, 0x0, 0x0, 
-0x0, 0xcddc39, 0x0, 0x0, 0x8bc34a, 0x8bc34a, 0x8bc34a, 0x0, 0x0, 0xcddc39, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x8bc34a, 0x4caf50, 0x8bc34a, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x4caf50, 0x4caf50, 0x4caf50, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x4caf50, 0x4caf50, 0x4caf50, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x4caf50, 0x0, 0x4caf50, 0x0, 0x4caf50, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x4caf50, 0x795548, 0x4caf50, 0x795548, 0x4caf50, 0x795548, 0x4caf50, 0x0, 0x0, 
-0x0, 0x4caf50, 0x795548, 0x4caf50, 0x795548, 0x4caf50, 0x795548, 0x4caf50, 0x795548, 0x4caf50, 0x0, 
+{ 0x0000, 0xcee7, 0xf206, 0x8e09, 0x4d6a, 0x7aa9, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x21, 0x11, 0x11, 0x01, 0x00, 0x11, 0x11, 0x11, 0x12, 0x01, 0x20, 0x11, 0x11, 0x11, 0x11,
+0x00, 0x10, 0x11, 0x11, 0x21, 0x00, 0x10, 0x00, 0x33, 0x03, 0x10, 0x00, 0x00, 0x30, 0x34, 0x00,
+0x00, 0x00, 0x00, 0x44, 0x04, 0x00, 0x00, 0x00, 0x40, 0x44, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40,
+0x00, 0x00, 0x40, 0x45, 0x45, 0x45, 0x00, 0x40, 0x45, 0x45, 0x45, 0x45, 0x00,
+}
 },
 //1 door closed
 {
-0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x0, 0x0, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0xcddc39, 0xcddc39, 0x3e2723, 0xcddc39, 0xcddc39, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0xcddc39, 0xcddc39, 0x3e2723, 0xcddc39, 0xcddc39, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0xcddc39, 0xcddc39, 0x3e2723, 0xcddc39, 0xcddc39, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 
+{ 0x0000, 0x3924, 0x63f1, 0xcee7, 0x42cc, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x10, 0x12, 0x12, 0x12, 0x02, 0x20, 0x21, 0x21, 0x21, 0x21, 0x21, 0x12, 0x12, 0x12, 0x12, 0x12,
+0x22, 0x21, 0x21, 0x21, 0x21, 0x21, 0x12, 0x32, 0x13, 0x33, 0x12, 0x22, 0x21, 0x33, 0x31, 0x23,
+0x21, 0x12, 0x32, 0x13, 0x33, 0x12, 0x22, 0x21, 0x21, 0x21, 0x21, 0x21, 0x12, 0x12, 0x12, 0x12,
+0x12, 0x22, 0x21, 0x21, 0x21, 0x21, 0x21, 0x44, 0x44, 0x44, 0x44, 0x44, 0x04,
+}
 },
 //2 door open
 {
-0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x0, 0x0, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0xcddc39, 0x0, 0x0, 0x0, 0xcddc39, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0xcddc39, 0x0, 0x0, 0x0, 0xcddc39, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x607d8b, 0x3e2723, 0x607d8b, 0x3e2723, 0x0, 0x0, 0x0, 0x3e2723, 0x607d8b, 0x3e2723, 0x607d8b, 
-0x455a64, 0x455a64, 0x455a64, 0x455a64, 0x0, 0x0, 0x0, 0x455a64, 0x455a64, 0x455a64, 0x455a64, 
+{ 0x0000, 0x3924, 0x63f1, 0xcee7, 0x42cc, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x10, 0x12, 0x00, 0x10, 0x02, 0x20, 0x21, 0x01, 0x00, 0x21, 0x21, 0x12, 0x12, 0x00, 0x10, 0x12,
+0x22, 0x21, 0x01, 0x00, 0x21, 0x21, 0x12, 0x32, 0x00, 0x30, 0x12, 0x22, 0x21, 0x03, 0x00, 0x23,
+0x21, 0x12, 0x12, 0x00, 0x10, 0x12, 0x22, 0x21, 0x01, 0x00, 0x21, 0x21, 0x12, 0x12, 0x00, 0x10,
+0x12, 0x22, 0x21, 0x01, 0x00, 0x21, 0x21, 0x44, 0x44, 0x00, 0x40, 0x44, 0x04,
+}
 },
 //3 key
 {
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0xff00, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0xff00, 0xf44336, 0xff00, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0xff00, 0xf44336, 0xf44336, 0xf44336, 0xff00, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0xff00, 0xf44336, 0xf44336, 0xff, 0xf44336, 0xf44336, 0xff00, 0xff00, 0xff00, 0xff00, 0xff00, 
-0x0, 0xff00, 0xf44336, 0xf44336, 0xf44336, 0xff00, 0x0, 0x0, 0xff00, 0x0, 0xff00, 
-0x0, 0x0, 0xff00, 0xf44336, 0xff00, 0x0, 0x0, 0x0, 0xff00, 0x0, 0xff00, 
-0x0, 0x0, 0x0, 0xff00, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 
+{ 0x0000, 0x07e0, 0xf206, 0x001f, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+0x00, 0x10, 0x12, 0x00, 0x00, 0x00, 0x10, 0x22, 0x12, 0x00, 0x00, 0x10, 0x22, 0x23, 0x12, 0x11,
+0x11, 0x10, 0x22, 0x12, 0x00, 0x01, 0x01, 0x10, 0x12, 0x00, 0x10, 0x10, 0x00, 0x10, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+}
 },
 //4 NPC
 {
-0x0, 0x0, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0x0, 0x0, 
-0x0, 0xcddc39, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xcddc39, 0x0, 
-0xcddc39, 0x0, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0xcddc39, 
-0xcddc39, 0x0, 0x0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x9c27b0, 0x0, 0x0, 0xcddc39, 
-0x0, 0xcddc39, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xcddc39, 0x0, 
-0x0, 0x0, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0xcddc39, 0x0, 0x0, 
+{ 0x0000, 0xcee7, 0x9936, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x11, 0x11, 0x11, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x20, 0x22, 0x22, 0x00,
+0x11, 0x20, 0x22, 0x22, 0x22, 0x10, 0x01, 0x22, 0x22, 0x22, 0x02, 0x11, 0x20, 0x22, 0x22, 0x22,
+0x10, 0x01, 0x22, 0x22, 0x22, 0x02, 0x11, 0x20, 0x22, 0x22, 0x22, 0x10, 0x01, 0x20, 0x22, 0x22,
+0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x11, 0x11, 0x11, 0x01, 0x00,
+}
 },
 //5 Player
 {
-0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x0, 0x0, 
-0x0, 0xf44336, 0x0, 0x181818, 0x4b4c4c, 0x323233, 0x0, 0x0, 0x0, 0xf44336, 0x0, 
-0xf44336, 0x0, 0x0, 0xf9fafb, 0xc7c7d4, 0xeeeff2, 0xfefefe, 0xffffff, 0x0, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xfafbfb, 0xdcdde4, 0xf8f9f9, 0xfeffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xfcfdfd, 0xfefefe, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0x0, 0xf44336, 
-0x0, 0xf44336, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0x0, 
-0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x0, 0x0, 
+{ 0x0000, 0xf206, 0x18c3, 0x4a69, 0x3186, 0xffdf, 0xc63a, 0xef7e, 0xffff, 0xdefc, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x11, 0x11, 0x11, 0x01, 0x00, 0x01, 0x32, 0x04, 0x00, 0x01, 0x01, 0x50, 0x76, 0x88, 0x00,
+0x11, 0x80, 0x95, 0x85, 0x88, 0x10, 0x01, 0x88, 0x88, 0x88, 0x08, 0x11, 0x80, 0x88, 0x88, 0x88,
+0x10, 0x01, 0x88, 0x88, 0x88, 0x08, 0x11, 0x80, 0x88, 0x88, 0x88, 0x10, 0x01, 0x80, 0x88, 0x88,
+0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x11, 0x11, 0x11, 0x01, 0x00,
+}
 },
 //6 Player with key
 {
-0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x0, 0x0, 
-0x0, 0xf44336, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0x0, 
-0xf44336, 0x0, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xff00, 0xff00, 0xff00, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xff00, 0xff, 0xff00, 0xff00, 0xff00, 0xff00, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xff00, 0xff00, 0xff00, 0xffffff, 0xffffff, 0xff00, 0x0, 0xf44336, 
-0xf44336, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0xf44336, 
-0xf44336, 0x0, 0x0, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0x0, 0x0, 0xf44336, 
-0x0, 0xf44336, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0x0, 
-0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x0, 0x0, 
+{ 0x0000, 0xf206, 0xffff, 0x07e0, 0x001f, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x11, 0x11, 0x11, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x20, 0x22, 0x22, 0x00,
+0x11, 0x20, 0x22, 0x22, 0x22, 0x10, 0x01, 0x32, 0x33, 0x22, 0x02, 0x11, 0x20, 0x43, 0x33, 0x33,
+0x10, 0x01, 0x32, 0x33, 0x22, 0x03, 0x11, 0x20, 0x22, 0x22, 0x22, 0x10, 0x01, 0x20, 0x22, 0x22,
+0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x11, 0x11, 0x11, 0x01, 0x00,
+}
 },
 //7 stairs
 {
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0xbf360c, 0x3e2723, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0x3e2723, 0xe65100, 
-0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf44336, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 
-0x0, 0x0, 0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 
-0x0, 0x0, 0x0, 0x0, 0xf44336, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 
-0x0, 0x0, 0xf44336, 0xf44336, 0xf44336, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 
-0x0, 0x0, 0xf44336, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 0xbf360c, 0x3e2723, 
-0xf44336, 0xf44336, 0xf44336, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 0x3e2723, 0xe65100, 
+{ 0x0000, 0xf206, 0xb9a1, 0x3924, 0xe280, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x11,
+0x01, 0x00, 0x00, 0x00, 0x10, 0x32, 0x00, 0x00, 0x00, 0x11, 0x31, 0x04, 0x00, 0x00, 0x10, 0x32,
+0x32, 0x00, 0x00, 0x11, 0x31, 0x34, 0x04, 0x00, 0x10, 0x32, 0x32, 0x32, 0x00, 0x11, 0x31, 0x34,
+0x34, 0x04, 0x10, 0x32, 0x32, 0x32, 0x32, 0x11, 0x31, 0x34, 0x34, 0x34, 0x04,
+}
 },
 //8 wall
 {
-0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 
-0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 
-0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 
-0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 
-0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 
-0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 
-0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 
-0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 
-0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 0x660101, 0xb80707, 0xb80707, 0xb80707, 0xb80707, 
-0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 
-0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 0x660101, 
+{ 0x6000, 0xb820, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x11, 0x01, 0x11, 0x11, 0x10, 0x11, 0x11, 0x10, 0x11,
+0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x01, 0x11, 0x11, 0x01, 0x11, 0x11, 0x10, 0x11, 0x11,
+0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x11, 0x01, 0x11, 0x11, 0x10, 0x11, 0x11, 0x10,
+0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+}
 },
 //9 throne
 {
-0x0, 0x0, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x0, 0x0, 
-0x0, 0x0, 0x607d8b, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x607d8b, 0x0, 0x0, 
-0x0, 0x0, 0x607d8b, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x607d8b, 0x0, 0x0, 
-0x0, 0x0, 0x607d8b, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x607d8b, 0x0, 0x0, 
-0x0, 0x607d8b, 0x607d8b, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0xf44336, 0x607d8b, 0x607d8b, 0x0, 
-0x0, 0x607d8b, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0x607d8b, 0x0, 
-0x0, 0x607d8b, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0x607d8b, 0x0, 
-0x0, 0x607d8b, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0x607d8b, 0x0, 
-0x0, 0x607d8b, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0x607d8b, 0x0, 
-0x0, 0x607d8b, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0xff5722, 0x607d8b, 0x0, 
-0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 0x607d8b, 
+{ 0x0000, 0x63f1, 0xf206, 0xfaa4, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+{
+0x00, 0x11, 0x11, 0x11, 0x01, 0x00, 0x10, 0x22, 0x22, 0x12, 0x00, 0x00, 0x21, 0x22, 0x22, 0x01,
+0x00, 0x10, 0x22, 0x22, 0x12, 0x00, 0x10, 0x21, 0x22, 0x22, 0x11, 0x00, 0x31, 0x33, 0x33, 0x33,
+0x01, 0x10, 0x33, 0x33, 0x33, 0x13, 0x00, 0x31, 0x33, 0x33, 0x33, 0x01, 0x10, 0x33, 0x33, 0x33,
+0x13, 0x00, 0x31, 0x33, 0x33, 0x33, 0x01, 0x11, 0x11, 0x11, 0x11, 0x11, 0x01,
+}
 },
 };
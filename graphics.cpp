@@ -5,113 +5,361 @@
 #include "frames.h"
 
 #include "hardware.h"
+#include "lcd.h"
 
+int lcd_tiles_sent = 0;
+int lcd_commands_sent = 0;
+int lcd_bytes_sent = 0;
+
+// Bytes each LCD command puts on the serial line: a 16-bit command and its
+// 16-bit arguments, plus 16 bits per pixel for a BLIT or a character for text
+#define BLIT_BYTES(w, h) (10 + 2 * (w) * (h))
+#define RECT_BYTES 12
+#define LINE_BYTES 12
+#define TEXT_BYTES(n) (16 + (n))
+
+/**
+ * Tiles held back by draw_cell, to go out as one command: a run of adjacent
+ * tiles across one row of the view, either sprites for one wide BLIT or blank
+ * tiles for one filled rectangle. The RGB565 pixels of a sprite run are kept
+ * with rows RUN_TILES tiles wide until the run is queued. A whole row of the
+ * view fits; making RUN_TILES smaller saves 242 bytes a tile, for more
+ * commands.
+ */
+#define RUN_TILES VIEW_W
+static unsigned short run_pixels[11*11 * RUN_TILES];
+static int run_u, run_v;     // Top left of the run
+static int run_n = 0;        // Tiles in the run, or 0 if none is held
+static int run_blank;        // If the run is blank tiles rather than sprites
+static int batching = false; // Set while draw_cell is drawing a tile
+
+/**
+ * Adds the tile at (u,v) to the held run, sending the run first and starting
+ * a new one if the tile does not continue it. Returns the tile's index in the
+ * run.
+ */
+static int join_run(int u, int v, int blank)
+{
+    if (run_n && (run_blank != blank || v != run_v || u != run_u + run_n*11
+                  || (!blank && run_n == RUN_TILES)))
+        flush_cells();
+    if (!run_n)
+    {
+        run_u = u;
+        run_v = v;
+        run_blank = blank;
+    }
+    return run_n++;
+}
+
+void flush_cells()
+{
+    if (!run_n) return;
+    if (run_blank)
+    {
+        lcd_fill(run_u, run_v, run_u + run_n*11 - 1, run_v + 10, BLACK);
+        lcd_bytes_sent += RECT_BYTES;
+    }
+    else
+    {
+        // Close up the rows of a run narrower than the buffer
+        int w = run_n * 11;
+        if (run_n < RUN_TILES)
+            for (int j = 1; j < 11; j++)
+                memmove(run_pixels + j*w, run_pixels + j*11*RUN_TILES, w * sizeof(run_pixels[0]));
+        lcd_blit(run_u, run_v, w, 11, run_pixels);
+        lcd_bytes_sent += BLIT_BYTES(w, 11);
+    }
+    lcd_commands_sent++;
+    run_n = 0;
+}
+
+/**
+ * Queues one 11x11 tile of RGB565 pixels, counting it, or adds it to the held
+ * run if draw_cell is drawing.
+ */
+static void blit_tile(int u, int v, const unsigned short* colors)
+{
+    lcd_tiles_sent++;
+    if (batching)
+    {
+        unsigned short* run = run_pixels + join_run(u, v, false) * 11;
+        for (int j = 0; j < 11; j++)
+            memcpy(run + j*11*RUN_TILES, colors + j*11, 11 * sizeof(colors[0]));
+        return;
+    }
+    flush_cells();
+    lcd_blit(u, v, 11, 11, colors);
+    lcd_commands_sent++;
+    lcd_bytes_sent += BLIT_BYTES(11, 11);
+}
+
+/**
+ * Expands sprite s from the store in flash to RGB565 pixels, and queues it.
+ */
+static void blit_sprite(int u, int v, const Sprite* s)
+{
+    const unsigned short* palette = s->palette;
+    unsigned short colors[11*11];
+    for (int i = 0; i < 11*11 - 1; i += 2)
+    {
+        int p = s->pixels[i/2];
+        colors[i] = palette[p & 0xF];
+        colors[i+1] = palette[p >> 4];
+    }
+    colors[11*11 - 1] = palette[s->pixels[11*11/2] & 0xF];
+    blit_tile(u, v, colors);
+}
+
+/**
+ * The screen shadow (see draw_cell). A NULL cell is not known and is always
+ * drawn, which is how the whole shadow starts out.
+ */
+static DrawFunc shadow[VIEW_H][VIEW_W];
+static DrawFunc status_icon;         // Lower status bar icon, at (0,119)
+static int border_shown = false;
+static int upper_line_shown = false; // Status bar borders
+static int lower_line_shown = false;
+static int shown_x = -1, shown_y = -1; // Position in the upper status bar
 
 void draw_player(int u, int v, int key)
 {
     if(!key)
-        uLCD.BLIT(u, v, 11, 11, sprite_frames[5]);
+        blit_sprite(u, v, &sprite_frames[5]);
     else
-        uLCD.BLIT(u, v, 11, 11, sprite_frames[6]);
+        blit_sprite(u, v, &sprite_frames[6]);
+}
+
+void draw_player_plain(int u, int v)
+{
+    draw_player(u, v, false);
+}
+
+void draw_player_key(int u, int v)
+{
+    draw_player(u, v, true);
+}
+
+int draw_cell(int i, int j, DrawFunc draw)
+{
+    if (shadow[j][i] == draw || !draw) return false;
+    batching = true;
+    draw(i*11 + 3, j*11 + 15);
+    batching = false;
+    shadow[j][i] = draw;
+    return true;
+}
+
+/**
+ * Returns true if pixel rectangles (x0,y0)-(x1,y1) and (a0,b0)-(a1,b1) overlap.
+ */
+static int overlaps(int x0, int y0, int x1, int y1, int a0, int b0, int a1, int b1)
+{
+    return x0 <= a1 && a0 <= x1 && y0 <= b1 && b0 <= y1;
+}
+
+void forget_screen(int x0, int y0, int x1, int y1)
+{
+    for (int j = 0; j < VIEW_H; j++)
+        for (int i = 0; i < VIEW_W; i++)
+            if (overlaps(x0, y0, x1, y1, i*11 + 3, j*11 + 15, i*11 + 13, j*11 + 25))
+                shadow[j][i] = NULL;
+    if (overlaps(x0, y0, x1, y1, 0, 119, 10, 129)) status_icon = NULL;
+
+    // The four sides of the border, as draw_border fills them
+    if (overlaps(x0, y0, x1, y1, 0, 9, 127, 14) || overlaps(x0, y0, x1, y1, 0, 13, 2, 114)
+        || overlaps(x0, y0, x1, y1, 0, 114, 127, 117) || overlaps(x0, y0, x1, y1, 124, 14, 127, 117))
+        border_shown = false;
+
+    if (overlaps(x0, y0, x1, y1, 0, 9, 127, 9)) upper_line_shown = false;
+    if (overlaps(x0, y0, x1, y1, 0, 0, 127, 7)) shown_x = shown_y = -1;
+    if (overlaps(x0, y0, x1, y1, 0, 118, 127, 118)) lower_line_shown = false;
 }
 
 #define YELLOW 0xFFFF00
 #define BROWN  0xD2691E
 #define DIRT   BROWN
+
+/**
+ * The RGB565 colour of each draw_img character. The characters without a
+ * colour, including everything past the last row here, are black (0).
+ */
+#define IMG_R RGB565(RED)
+#define IMG_Y RGB565(YELLOW)
+#define IMG_G RGB565(GREEN)
+#define IMG_D RGB565(DIRT)
+#define IMG_5 RGB565(LGREY)
+#define IMG_3 RGB565(DGREY)
+static const unsigned short img_colors[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20
+    0, 0, 0, IMG_3, 0, IMG_5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x30: '3' '5'
+    0, 0, 0, 0, IMG_D, 0, 0, IMG_G, 0, 0, 0, 0, 0, 0, 0, 0, // 0x40: 'D' 'G'
+    0, 0, IMG_R, 0, 0, 0, 0, 0, 0, IMG_Y, 0, 0, 0, 0, 0, 0, // 0x50: 'R' 'Y'
+};
+
+/**
+ * Images draw_img has decoded, by the address of the image string, so drawing
+ * one again is just the BLIT. The least recently used one makes way.
+ */
+#define IMG_CACHE 4
+typedef struct {
+    const char* img;    // Image string, or NULL if unused
+    unsigned used;      // Last use, for evicting the least recently used image
+    unsigned short colors[11*11];
+} DecodedImg;
+static DecodedImg img_cache[IMG_CACHE];
+static unsigned img_clock = 0;
+
 void draw_img(int u, int v, const char* img)
 {
-    int colors[11*11];
-    for (int i = 0; i < 11*11; i++)
+    // Look for the image, or else take the least recently used entry
+    DecodedImg* d = &img_cache[0];
+    for (int i = 0; i < IMG_CACHE; i++)
     {
-        if (img[i] == 'R') colors[i] = RED;
-        else if (img[i] == 'Y') colors[i] = YELLOW;
-        else if (img[i] == 'G') colors[i] = GREEN;
-        else if (img[i] == 'D') colors[i] = DIRT;
-        else if (img[i] == '5') colors[i] = LGREY;
-        else if (img[i] == '3') colors[i] = DGREY;
-        else colors[i] = BLACK;
+        DecodedImg* e = &img_cache[i];
+        if (e->img == img)
+        {
+            d = e;
+            break;
+        }
+        if (e->used < d->used) d = e;
     }
-    uLCD.BLIT(u, v, 11, 11, colors);
-    wait_us(250); // Recovery time!
+    d->used = ++img_clock;
+    if (d->img != img)
+    {
+        for (int i = 0; i < 11*11; i++)
+            d->colors[i] = img_colors[(unsigned char) img[i]];
+        d->img = img;
+    }
+
+    // No recovery time needed: the queue waits for the LCD to reply
+    blit_tile(u, v, d->colors);
 }
 
 void draw_nothing(int u, int v)
 {
     // Fill a tile with blackness
-    uLCD.filled_rectangle(u, v, u+10, v+10, BLACK);
+    lcd_tiles_sent++;
+    if (batching)
+    {
+        join_run(u, v, true);
+        return;
+    }
+    flush_cells();
+    lcd_fill(u, v, u+10, v+10, BLACK);
+    lcd_commands_sent++;
+    lcd_bytes_sent += RECT_BYTES;
 }
 
 void draw_wall(int u, int v)
 {
-    uLCD.BLIT(u, v, 11, 11, sprite_frames[8]);
+    blit_sprite(u, v, &sprite_frames[8]);
 }
 
 void draw_plant(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[0]);
+    blit_sprite(u, v, &sprite_frames[0]);
 }
 
 void draw_NPC(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[4]);
+    blit_sprite(u, v, &sprite_frames[4]);
 }
 
 void draw_key(int u, int v)
 {
-    uLCD.BLIT(u, v, 11, 11, sprite_frames[3]);
+    blit_sprite(u, v, &sprite_frames[3]);
 }
 
 void draw_door_closed(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[1]);
+    blit_sprite(u, v, &sprite_frames[1]);
 }
 
 void draw_door_open(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[2]);
+    blit_sprite(u, v, &sprite_frames[2]);
 }
 
 void draw_stairs(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[7]);
+    blit_sprite(u, v, &sprite_frames[7]);
 }
 
 void draw_win_item(int u, int v)
 {
-    uLCD.BLIT(u , v, 11, 11, sprite_frames[9]);
+    blit_sprite(u, v, &sprite_frames[9]);
 }
 
 void draw_upper_status(int player_x, int player_y)
 {
     // Draw bottom border of status bar
-    uLCD.line(0, 9, 127, 9, GREEN);
+    if (!upper_line_shown)
+    {
+        lcd_fence();
+        uLCD.line(0, 9, 127, 9, GREEN);
+        lcd_commands_sent++;
+        lcd_bytes_sent += LINE_BYTES;
+        upper_line_shown = true;
+    }
 
     // Add other status info drawing code here
-    char posString[16];
-    sprintf(posString, "Position: %u, %u ", player_x, player_y);
-    uLCD.text_string(posString, 0, 0, FONT_5X7, YELLOW);
+    if (player_x != shown_x || player_y != shown_y)
+    {
+        char posString[32];
+        snprintf(posString, sizeof(posString), "Position: %u, %u ", player_x, player_y);
+        lcd_fence();
+        uLCD.text_string(posString, 0, 0, FONT_5X7, YELLOW);
+        lcd_commands_sent++;
+        lcd_bytes_sent += TEXT_BYTES(strlen(posString));
+        shown_x = player_x;
+        shown_y = player_y;
+    }
 }
 
 void draw_lower_status(int key)
 {
     // Draw top border of status bar
-    uLCD.line(0, 118, 127, 118, GREEN);
+    if (!lower_line_shown)
+    {
+        lcd_fence();
+        uLCD.line(0, 118, 127, 118, GREEN);
+        lcd_commands_sent++;
+        lcd_bytes_sent += LINE_BYTES;
+        lower_line_shown = true;
+    }
 
     // Add other status info drawing code here
-    if(key)
-        draw_key(0, 119);
+    DrawFunc icon = (key) ? draw_key : draw_nothing;
+    if (icon != status_icon)
+    {
+        icon(0, 119);
+        status_icon = icon;
+    }
 }
 
 void draw_border()
 {
-    uLCD.filled_rectangle(0,     9, 127,  14, WHITE); // Top
-    uLCD.filled_rectangle(0,    13,   2, 114, WHITE); // Left
-    uLCD.filled_rectangle(0,   114, 127, 117, WHITE); // Bottom
-    uLCD.filled_rectangle(124,  14, 127, 117, WHITE); // Right
+    if (border_shown) return;
+    lcd_fill(0,     9, 127,  14, WHITE); // Top
+    lcd_fill(0,    13,   2, 114, WHITE); // Left
+    lcd_fill(0,   114, 127, 117, WHITE); // Bottom
+    lcd_fill(124,  14, 127, 117, WHITE); // Right
+    lcd_commands_sent += 4;
+    lcd_bytes_sent += 4 * RECT_BYTES;
+    border_shown = true;
+
+    // The top of the border covers the upper status bar's line
+    upper_line_shown = false;
 }
 
 void draw_game_over(int win)
 {
+    // Finish the last frame before writing over it
+    lcd_fence();
+
     // Cover map
     uLCD.filled_rectangle(3, 15, 126, 113, BLACK);
 
@@ -126,6 +374,7 @@ void draw_game_over(int win)
     }
     else
         uLCD.text_string("YOU DIED", 5, 8, FONT_5X7, RED);
+    forget_screen(3, 15, 126, 113);
 }
 
 void draw_start_page()
@@ -133,7 +382,8 @@ void draw_start_page()
     // fill in borders
     draw_border();
 
-    // Cover map
+    // Cover map, once the border is out
+    lcd_fence();
     uLCD.filled_rectangle(3, 15, 126, 113, BLACK);
 
     // Write message
@@ -141,6 +391,7 @@ void draw_start_page()
     uLCD.text_string("by Benjamin", 4, 6, FONT_5X7, BLUE);
     uLCD.text_string("Ventimiglia", 4, 7, FONT_5X7, BLUE);
     uLCD.text_string("PRESS START", 4, 12, FONT_5X7, BLUE);
+    forget_screen(3, 15, 126, 113);
 
     GameInputs in;
 
@@ -1,12 +1,24 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include "map.h"
+
+// Visible tiles across and down the map view
+#define VIEW_W 11
+#define VIEW_H 9
 
 /**
  * Draws the player. This depends on the player state, so it is not a DrawFunc.
  */
 void draw_player(int u, int v, int key);
 
+/**
+ * The player without and with the key, as DrawFuncs, so the player's cell can
+ * go through draw_cell like any other.
+ */
+void draw_player_plain(int u, int v);
+void draw_player_key(int u, int v);
+
 /**
  * Takes a string image and draws it to the screen. The string is 121 characters
  * long, and represents an 11x11 tile in row-major ordering (across, then down,
@@ -18,7 +30,10 @@ void draw_player(int u, int v, int key);
  *      5 = Light grey (50%)
  *      3 = Dark grey (30%)
  *      Any other character is black
- * More colors can be easily added by following the pattern already given.
+ * More colors can be easily added to the table in graphics.cpp.
+ *
+ * Decoded images are cached by the address of the string, so an image must
+ * not be changed once it has been drawn (string constants are ideal).
  */
 void draw_img(int u, int v, const char* img);
 
@@ -37,17 +52,53 @@ void draw_stairs(int u, int v);
 void draw_win_item(int u, int v);
 
 /**
- * Draw the upper status bar.
+ * The screen shadow. It records what was last sent to each cell of the map
+ * view, and whether the border and status bars are on screen, so that only
+ * what changed is sent to the LCD.
+ *
+ * draw_cell draws cell (i,j) of the view ((0,0) is the top left) with draw,
+ * unless draw is what the shadow says is already there. Returns true if it
+ * drew.
+ */
+int draw_cell(int i, int j, DrawFunc draw);
+
+/**
+ * draw_cell holds back runs of tiles across a row, to send each run as one
+ * wide BLIT (or one fill, for blank tiles). Sends whatever is held; call it
+ * once the cells of a frame are drawn.
+ */
+void flush_cells();
+
+/**
+ * Forgets what is on screen in the pixel rectangle (x0,y0)-(x1,y1), so the
+ * cells, border and status bars there are drawn again. Anything that draws
+ * over the screen other than through the functions here (a speech bubble, a
+ * game over message) must call this for the area it covered.
+ */
+void forget_screen(int x0, int y0, int x1, int y1);
+
+/**
+ * What the functions here have sent to the LCD since the counters were last
+ * zeroed: 11x11 tiles, LCD commands (a run of tiles sent together is one),
+ * and an estimate of the bytes on the serial line, from the size of each
+ * command and its pixels.
+ */
+extern int lcd_tiles_sent;
+extern int lcd_commands_sent;
+extern int lcd_bytes_sent;
+
+/**
+ * Draw the upper status bar, if it changed.
  */
 void draw_upper_status(int player_x, int player_y);
 
 /**
- * Draw the lower status bar.
+ * Draw the lower status bar, if it changed.
  */
 void draw_lower_status(int key);
 
 /**
- * Draw the border for the map.
+ * Draw the border for the map, if it is not on screen.
  */
 void draw_border();
 
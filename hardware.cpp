@@ -4,13 +4,14 @@
 #include "globals.h"
 
 #include "hardware.h"
+#include "lcd.h"
 
 // We need to actually instantiate all of the globals (i.e. declare them once
 // without the extern keyword). That's what this file does!
 
 // Hardware initialization: Instantiate all the things!
 uLCD_4DGL uLCD(p9,p10,p11);             // LCD Screen (tx, rx, reset)
-//SDFileSystem sd(p5, p6, p7, p8, "sd");  // SD Card(mosi, miso, sck, cs)
+SDFileSystem sd(p5, p6, p7, p8, "sd");  // SD Card(mosi, miso, sck, cs)
 Serial pc(USBTX,USBRX);                 // USB Console (tx, rx)
 MMA8452 acc(p28, p27, 100000);        // Accelerometer (sda, sdc, rate)
 DigitalIn button1(p21);                 // Pushbuttons (pin)
@@ -26,6 +27,7 @@ int hardware_init()
 {
     // Crank up the speed
     uLCD.baudrate(3000000);
+    lcd_init(3000000);
    // pc.baud(115200);
 
     //Initialize pushbuttons
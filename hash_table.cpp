@@ -63,7 +63,32 @@ Naming conventions in this file:
 * but are not required by users of the hash table.
 ***************************************************************************/
 #include <stdlib.h>   // For malloc and free
-#include <stdio.h>    // For printf
+
+
+/****************************************************************************
+* Resizing Policy
+*
+* A table grows to twice its size once its load (items per bucket, as a
+* percentage) passes the limit for its engine, and shrinks to half its size,
+* but never below the size it was created with, once the load drops under
+* MIN_LOAD_PERCENT. The old items are moved over REHASH_STEP buckets at a time
+* by later calls, so no single call pays for a full rehash.
+***************************************************************************/
+#define CHAINED_MAX_LOAD_PERCENT 200
+#define OPEN_MAX_LOAD_PERCENT    75
+#define MIN_LOAD_PERCENT         20
+#define REHASH_STEP              4
+
+/****************************************************************************
+* Entry Pool
+*
+* Chained tables do not malloc their HashTableEntry nodes one at a time. Each
+* table hands them out of its own pool: first from a free list of released
+* entries, then from an optional buffer supplied with hashTableUseBuffer, and
+* only then from slabs of POOL_SLAB_ENTRIES entries taken from the heap, or
+* from the table's HashAllocator if it has one.
+***************************************************************************/
+#define POOL_SLAB_ENTRIES 32
 
 
 /****************************************************************************
@@ -73,20 +98,77 @@ Naming conventions in this file:
 * they are forward declared in hash_table.h, the type names are
 * available everywhere and user code can hold pointers to these structs.
 ***************************************************************************/
+typedef struct _HashTableSlot HashTableSlot;
+typedef struct _EntrySlab EntrySlab;
+
 /**
  * This structure represents an a hash table.
  * Use "HashTable" instead when you are creating a new variable. [See top comments]
  */
 struct _HashTable {
   /** The array of pointers to the head of a singly linked list, whose nodes
-      are HashTableEntry objects */
+      are HashTableEntry objects (HASH_CHAINED only) */
   HashTableEntry** buckets;
 
+  /** The contiguous array of inline key/value slots (HASH_OPEN only) */
+  HashTableSlot* slots;
+
   /** The hash function pointer */
   HashFunction hash;
 
-  /** The number of buckets in the hash table */
+  /** Where the table gets its memory; alloc is NULL for the heap */
+  HashAllocator allocator;
+
+  /** The number of buckets (or slots, for HASH_OPEN) in the hash table */
   unsigned int num_buckets;
+
+  /** The number of buckets the table was created with; it never shrinks below this */
+  unsigned int min_buckets;
+
+  /** The number of items currently stored in the table */
+  unsigned int num_items;
+
+  /** The storage engine, HASH_CHAINED or HASH_OPEN */
+  int mode;
+
+  /** The arrays being drained by an incremental resize, or NULL */
+  HashTableEntry** old_buckets;
+  HashTableSlot* old_slots;
+
+  /** The size of the array being drained, or 0 if no resize is in progress */
+  unsigned int old_num_buckets;
+
+  /** The number of items still waiting in old_slots (HASH_OPEN only) */
+  unsigned int old_items;
+
+  /** The next bucket of the old array to be moved */
+  unsigned int rehash_index;
+
+  /** Released entries, linked through their next pointers */
+  HashTableEntry* pool_free;
+
+  /** The unused part of the newest slab or caller buffer */
+  HashTableEntry* pool_next;
+  HashTableEntry* pool_end;
+
+  /** The slabs taken from the heap, freed together by destroyHashTable */
+  EntrySlab* pool_slabs;
+
+  /** Pool counters: entries available, entries in use and the most ever in use */
+  unsigned int pool_capacity;
+  unsigned int pool_used;
+  unsigned int pool_high_water;
+
+#if HASH_TABLE_STATS
+  /** Entries or slots examined by the current lookup */
+  unsigned int probe_count;
+
+  /** getItem counters, see HashTableStats */
+  unsigned int stat_gets;
+  unsigned int stat_hits;
+  unsigned int stat_probes;
+  unsigned int stat_max_probes;
+#endif
 };
 
 /**
@@ -107,6 +189,51 @@ struct _HashTableEntry {
   HashTableEntry* next;
 };
 
+/**
+ * This structure represents one inline slot of an open addressing table.
+ * Use "HashTableSlot" instead when you are creating a new variable.
+ */
+struct _HashTableSlot {
+  /** The key stored in this slot */
+  unsigned int key;
+
+  /** The value associated with the key */
+  void* value;
+
+  /**
+  * One more than the distance of this slot from the key's home slot.
+  * 0 means the slot is empty.
+  */
+  unsigned int dist;
+};
+
+/**
+ * This structure is the header of a slab of pool entries taken from the heap.
+ * The entries themselves follow the header in the same allocation.
+ */
+struct _EntrySlab {
+  /** The previously allocated slab, or NULL */
+  EntrySlab* next;
+};
+
+/**
+ * The value left behind in a slot of the old array once its item has been
+ * moved or removed during a resize. The slot keeps its dist so that probes for
+ * the keys behind it still reach them.
+ */
+static char movedMarker;
+#define MOVED ((void*)&movedMarker)
+
+/**
+ * Count one examined entry or slot towards the statistics of the table.
+ * This compiles to nothing when HASH_TABLE_STATS is off.
+ */
+#if HASH_TABLE_STATS
+#define COUNT_PROBE(table) ((table)->probe_count++)
+#else
+#define COUNT_PROBE(table)
+#endif
+
 
 /****************************************************************************
 * Private Functions
@@ -114,25 +241,100 @@ struct _HashTableEntry {
 * These functions are not available outside of this file, since they are not
 * declared in hash_table.h.
 ***************************************************************************/
+/**
+* tableAlloc
+*
+* Helper function that allocates memory for a table, from its allocator if it
+* has one and from the heap otherwise.
+*
+* @param allocator The table's allocator
+* @param size The number of bytes to allocate
+* @return The pointer to the memory, or NULL if there is none left
+*/
+static void* tableAlloc(const HashAllocator* allocator, unsigned int size) {
+  if(allocator->alloc) {
+    return allocator->alloc(allocator->context, size);
+  }
+  return malloc(size);
+}
+
+/**
+* tableFree
+*
+* Helper function that gives memory (or a value) back to where tableAlloc got
+* it from.
+*
+* @param allocator The table's allocator
+* @param block The memory to free; NULL is ignored
+*/
+static void tableFree(const HashAllocator* allocator, void* block) {
+  if(block == NULL) {
+    return;
+  }
+  if(allocator->alloc) {
+    allocator->release(allocator->context, block);
+  }
+  else {
+    free(block);
+  }
+}
+
+/**
+* addSlab
+*
+* Helper function that takes a new slab of POOL_SLAB_ENTRIES entries from the
+* heap (or the table's allocator) and makes it the pool's unused region.
+*
+* @param hashTable The pointer to the hash table.
+* @return 1, or 0 if there was no memory for the slab
+*/
+static int addSlab(HashTable* hashTable) {
+  EntrySlab* slab = (EntrySlab*)tableAlloc(&hashTable->allocator,
+                                           sizeof(EntrySlab) + POOL_SLAB_ENTRIES*sizeof(HashTableEntry));
+
+  // Check if malloc failed
+  if (slab == NULL) {
+    return 0;
+  }
+
+  slab->next = hashTable->pool_slabs;
+  hashTable->pool_slabs = slab;
+  hashTable->pool_next = (HashTableEntry*)(slab + 1);
+  hashTable->pool_end = hashTable->pool_next + POOL_SLAB_ENTRIES;
+  hashTable->pool_capacity += POOL_SLAB_ENTRIES;
+  return 1;
+}
+
 /**
 * createHashTableEntry
 *
-* Helper function that creates a hash table entry by allocating memory for it on
-* the heap. It initializes the entry with key and value, initialize pointer to
-* the next entry as NULL, and return the pointer to this hash table entry.
+* Helper function that creates a hash table entry by taking one from the
+* table's pool. It initializes the entry with key and value, initialize pointer
+* to the next entry as NULL, and return the pointer to this hash table entry.
 *
+* @param hashTable The pointer to the hash table that will own the entry
 * @param key The key corresponds to the hash table entry
 * @param value The value stored in the hash table entry
-* @return The pointer to the hash table entry
+* @return The pointer to the hash table entry, or NULL if there was no memory
 */
-static HashTableEntry* createHashTableEntry(unsigned int key, void* value) {
-  // Allocate space for the new entry
-  HashTableEntry* newEntry = (HashTableEntry*)malloc(sizeof(HashTableEntry));
+static HashTableEntry* createHashTableEntry(HashTable* hashTable, unsigned int key, void* value) {
+  HashTableEntry* newEntry;
 
-  // Check if malloc failed
-  if (newEntry == NULL) {
-    printf("\tCreateHashtableEntry: Malloc has failed. Exiting.");
-    exit(1);
+  // Reuse a released entry if there is one, otherwise carve a fresh one
+  if (hashTable->pool_free) {
+    newEntry = hashTable->pool_free;
+    hashTable->pool_free = newEntry->next;
+  }
+  else {
+    if (hashTable->pool_next == hashTable->pool_end && !addSlab(hashTable)) {
+      return NULL;
+    }
+    newEntry = hashTable->pool_next++;
+  }
+
+  // Keep the pool counters up to date
+  if (++hashTable->pool_used > hashTable->pool_high_water) {
+    hashTable->pool_high_water = hashTable->pool_used;
   }
 
   // Initialize new entry's values
@@ -144,6 +346,90 @@ static HashTableEntry* createHashTableEntry(unsigned int key, void* value) {
   return newEntry;
 }
 
+/**
+* destroyHashTableEntry
+*
+* Helper function that gives an entry back to the table's pool.
+*
+* @param hashTable The pointer to the hash table that owns the entry
+* @param entry The entry to release
+*/
+static void destroyHashTableEntry(HashTable* hashTable, HashTableEntry* entry) {
+  entry->next = hashTable->pool_free;
+  hashTable->pool_free = entry;
+  hashTable->pool_used--;
+}
+
+/**
+* createBuckets
+*
+* Helper function that allocates an array of empty buckets.
+*
+* @param hashTable The pointer to the hash table.
+* @param numBuckets The number of buckets to allocate
+* @return The pointer to the first bucket, or NULL if there was no memory
+*/
+static HashTableEntry** createBuckets(HashTable* hashTable, unsigned int numBuckets) {
+  HashTableEntry** buckets = (HashTableEntry**)tableAlloc(&hashTable->allocator,
+                                                          numBuckets*sizeof(HashTableEntry*));
+  if (buckets == NULL) {
+    return NULL;
+  }
+
+  // As the new buckets contain indeterminant values, init each bucket as NULL.
+  unsigned int i;
+  for (i=0; i<numBuckets; ++i) {
+    buckets[i] = NULL;
+  }
+  return buckets;
+}
+
+/**
+* findLink
+*
+* Helper function that looks for a key in one array of buckets.
+*
+* @param hashTable The pointer to the hash table.
+* @param buckets The array of buckets to search
+* @param numBuckets The number of buckets in that array
+* @param key The key corresponds to the hash table entry
+* @return The pointer to the link (the bucket head or the previous entry's next
+*         pointer) that points at the entry, or NULL if key does not exist
+*/
+static HashTableEntry** findLink(HashTable* hashTable, HashTableEntry** buckets,
+                                 unsigned int numBuckets, unsigned int key) {
+  HashTableEntry** link = &buckets[hashTable->hash(key) & (numBuckets - 1)];
+
+  // Iterate through the bucket to find the entry with the given key
+  while(*link != NULL) {
+    COUNT_PROBE(hashTable);
+    if((*link)->key == key) {
+      return link;
+    }
+    link = &(*link)->next;
+  }
+  // If no entry is found, the key does not exist and the function returns NULL
+  return NULL;
+}
+
+/**
+* findEntryLink
+*
+* Helper function that looks for a key in a chained table. While a resize is
+* in progress the key may still be waiting in the old array.
+*
+* @param hashTable The pointer to the hash table.
+* @param key The key corresponds to the hash table entry
+* @return The link that points at the entry, or NULL if key does not exist
+*/
+static HashTableEntry** findEntryLink(HashTable* hashTable, unsigned int key) {
+  HashTableEntry** link = findLink(hashTable, hashTable->buckets, hashTable->num_buckets, key);
+  if(link == NULL && hashTable->old_num_buckets) {
+    link = findLink(hashTable, hashTable->old_buckets, hashTable->old_num_buckets, key);
+  }
+  return link;
+}
+
 /**
 * findItem
 *
@@ -155,26 +441,282 @@ static HashTableEntry* createHashTableEntry(unsigned int key, void* value) {
 * @return The pointer to the hash table entry, or NULL if key does not exist
 */
 static HashTableEntry* findItem(HashTable* hashTable, unsigned int key) {
-  unsigned int index = hashTable->hash(key);
-
-  // Get the head entry in the correct bucket
-  HashTableEntry* entry = hashTable->buckets[index];
+  HashTableEntry** link = findEntryLink(hashTable, key);
+  return (link) ? *link : NULL;
+}
 
-  // If no entry exists, there is no list to look through
-  if(entry == NULL) {
+/**
+* createSlots
+*
+* Helper function that allocates an array of empty open addressing slots.
+*
+* @param hashTable The pointer to the hash table.
+* @param numSlots The number of slots to allocate
+* @return The pointer to the first slot, or NULL if there was no memory
+*/
+static HashTableSlot* createSlots(HashTable* hashTable, unsigned int numSlots) {
+  HashTableSlot* slots = (HashTableSlot*)tableAlloc(&hashTable->allocator,
+                                                    numSlots*sizeof(HashTableSlot));
+  if (slots == NULL) {
     return NULL;
   }
 
+  // A dist of 0 marks a slot as empty
+  unsigned int i;
+  for (i=0; i<numSlots; ++i) {
+    slots[i].dist = 0;
+  }
+  return slots;
+}
 
-  // Iterate through the bucket to find the entry with the given key
-  while(entry != NULL) {
-    if(entry->key == key) {
-      return entry;
+/**
+* findSlotIn
+*
+* Helper function that finds the open addressing slot holding a specific key.
+* Robin Hood ordering means every key between a key's home slot and its actual
+* slot is at least as far from home, so the search can stop as soon as it meets
+* a slot that is closer to its own home than the key would be.
+*
+* @param hashTable The pointer to the hash table.
+* @param slots The array of slots to search
+* @param numSlots The number of slots in that array
+* @param key The key corresponds to the slot
+* @return The pointer to the slot, or NULL if key does not exist
+*/
+static HashTableSlot* findSlotIn(HashTable* hashTable, HashTableSlot* slots,
+                                 unsigned int numSlots, unsigned int key) {
+  unsigned int index = hashTable->hash(key) & (numSlots - 1);
+  unsigned int dist = 1;
+
+  while(1) {
+    HashTableSlot* slot = &slots[index];
+    COUNT_PROBE(hashTable);
+    if(slot->dist < dist) {
+      return NULL;
+    }
+    if(slot->key == key && slot->value != MOVED) {
+      return slot;
+    }
+    if(++index == numSlots) {
+      index = 0;
     }
-    entry = entry->next;
+    dist++;
+  }
+}
+
+/**
+* findSlot
+*
+* Helper function that looks for a key in an open addressing table, including
+* the old array while a resize is in progress.
+*
+* @param hashTable The pointer to the hash table.
+* @param key The key corresponds to the slot
+* @return The pointer to the slot, or NULL if key does not exist
+*/
+static HashTableSlot* findSlot(HashTable* hashTable, unsigned int key) {
+  HashTableSlot* slot = findSlotIn(hashTable, hashTable->slots, hashTable->num_buckets, key);
+  if(slot == NULL && hashTable->old_num_buckets) {
+    slot = findSlotIn(hashTable, hashTable->old_slots, hashTable->old_num_buckets, key);
+  }
+  return slot;
+}
+
+/**
+* placeSlot
+*
+* Helper function that places a key that is known not to be in the table into
+* the current slot array. Whenever the new key is further from home than the
+* key sitting in a slot, the two swap places and the displaced key continues
+* probing.
+*
+* @param hashTable The pointer to the hash table.
+* @param key The key to place
+* @param value The value associated with the key
+*/
+static void placeSlot(HashTable* hashTable, unsigned int key, void* value) {
+  HashTableSlot current;
+  current.key = key;
+  current.value = value;
+  current.dist = 1;
+
+  unsigned int index = hashTable->hash(key) & (hashTable->num_buckets - 1);
+  while(1) {
+    HashTableSlot* slot = &hashTable->slots[index];
+    if(slot->dist == 0) {
+      *slot = current;
+      return;
+    }
+    if(slot->dist < current.dist) {
+      HashTableSlot temp = *slot;
+      *slot = current;
+      current = temp;
+    }
+    if(++index == hashTable->num_buckets) {
+      index = 0;
+    }
+    current.dist++;
+  }
+}
+
+/**
+* removeSlot
+*
+* Helper function that empties a slot of an open addressing table. In the
+* current array the following keys that are away from home are shifted back by
+* one instead of leaving a tombstone, which keeps every probe sequence short
+* and unbroken. In the old array of a resize the slot is only marked MOVED, so
+* the slots that have not been moved yet stay where the resize expects them.
+*
+* @param hashTable The pointer to the hash table.
+* @param slot The slot to empty
+* @return The value that was stored in the slot
+*/
+static void* removeSlot(HashTable* hashTable, HashTableSlot* slot) {
+  void* value = slot->value;
+  hashTable->num_items--;
+
+  if(hashTable->old_num_buckets && slot >= hashTable->old_slots &&
+     slot < hashTable->old_slots + hashTable->old_num_buckets) {
+    slot->value = MOVED;
+    hashTable->old_items--;
+    return value;
+  }
+
+  unsigned int index = slot - hashTable->slots;
+  unsigned int next = (index + 1 == hashTable->num_buckets) ? 0 : index + 1;
+
+  while(hashTable->slots[next].dist > 1) {
+    hashTable->slots[index] = hashTable->slots[next];
+    hashTable->slots[index].dist--;
+    index = next;
+    next = (next + 1 == hashTable->num_buckets) ? 0 : next + 1;
+  }
+  hashTable->slots[index].dist = 0;
+  return value;
+}
+
+/**
+* rehashStep
+*
+* Helper function that moves the next REHASH_STEP buckets (or slots) of an
+* in-progress resize into the current array. The old array is freed once it
+* has been drained.
+*
+* @param hashTable The pointer to the hash table.
+*/
+static void rehashStep(HashTable* hashTable) {
+  unsigned int steps;
+  for(steps = 0; steps < REHASH_STEP && hashTable->rehash_index < hashTable->old_num_buckets; steps++) {
+    unsigned int i = hashTable->rehash_index++;
+
+    if(hashTable->mode == HASH_OPEN) {
+      HashTableSlot* slot = &hashTable->old_slots[i];
+      if(slot->dist && slot->value != MOVED) {
+        placeSlot(hashTable, slot->key, slot->value);
+        slot->value = MOVED;
+        hashTable->old_items--;
+      }
+      continue;
+    }
+
+    // Relink every entry of the old bucket into its new bucket
+    HashTableEntry* entry = hashTable->old_buckets[i];
+    while(entry) {
+      HashTableEntry* next = entry->next;
+      unsigned int index = hashTable->hash(entry->key) & (hashTable->num_buckets - 1);
+      entry->next = hashTable->buckets[index];
+      hashTable->buckets[index] = entry;
+      entry = next;
+    }
+    hashTable->old_buckets[i] = NULL;
+  }
+
+  // Once every old bucket has been moved the old array can go
+  if(hashTable->rehash_index == hashTable->old_num_buckets) {
+    tableFree(&hashTable->allocator, hashTable->old_buckets);
+    tableFree(&hashTable->allocator, hashTable->old_slots);
+    hashTable->old_buckets = NULL;
+    hashTable->old_slots = NULL;
+    hashTable->old_num_buckets = 0;
+  }
+}
+
+/**
+* finishRehash
+*
+* Helper function that completes an in-progress resize immediately.
+*
+* @param hashTable The pointer to the hash table.
+*/
+static void finishRehash(HashTable* hashTable) {
+  while(hashTable->old_num_buckets) {
+    rehashStep(hashTable);
+  }
+}
+
+/**
+* checkLoad
+*
+* Helper function that starts a resize when the load of the table has left the
+* range allowed by the resizing policy. Only the new array is allocated here;
+* the items are moved by rehashStep on later calls.
+*
+* If there is no memory for the new array the table just stays the size it is,
+* and the next call tries again.
+*
+* @param hashTable The pointer to the hash table.
+*/
+static void checkLoad(HashTable* hashTable) {
+  // Only one resize can be in progress at a time
+  if(hashTable->old_num_buckets) {
+    return;
+  }
+
+  unsigned int maxLoad = (hashTable->mode == HASH_OPEN) ? OPEN_MAX_LOAD_PERCENT : CHAINED_MAX_LOAD_PERCENT;
+  unsigned int load = hashTable->num_items * 100 / hashTable->num_buckets;
+  unsigned int newNumBuckets;
+
+  if(load > maxLoad) {
+    newNumBuckets = hashTable->num_buckets * 2;
+  }
+  else if(load < MIN_LOAD_PERCENT && hashTable->num_buckets > hashTable->min_buckets) {
+    newNumBuckets = hashTable->num_buckets / 2;
+    if(newNumBuckets < hashTable->min_buckets) {
+      newNumBuckets = hashTable->min_buckets;
+    }
+  }
+  else {
+    return;
+  }
+
+  // Allocate the new array before touching the table, so that it is left as
+  // it was if there is no memory
+  HashTableSlot* newSlots = NULL;
+  HashTableEntry** newBuckets = NULL;
+  if(hashTable->mode == HASH_OPEN) {
+    newSlots = createSlots(hashTable, newNumBuckets);
+  }
+  else {
+    newBuckets = createBuckets(hashTable, newNumBuckets);
+  }
+  if(newSlots == NULL && newBuckets == NULL) {
+    return;
+  }
+
+  // The current array becomes the old array, to be drained step by step
+  hashTable->old_num_buckets = hashTable->num_buckets;
+  hashTable->num_buckets = newNumBuckets;
+  hashTable->rehash_index = 0;
+  if(hashTable->mode == HASH_OPEN) {
+    hashTable->old_slots = hashTable->slots;
+    hashTable->old_items = hashTable->num_items;
+    hashTable->slots = newSlots;
+  }
+  else {
+    hashTable->old_buckets = hashTable->buckets;
+    hashTable->buckets = newBuckets;
   }
-  // If no entry is found, the key does not exist and the function returns NULL
-  return NULL;
 }
 
 /****************************************************************************
@@ -184,27 +726,71 @@ static HashTableEntry* findItem(HashTable* hashTable, unsigned int key) {
 * file, and make use of the private functions and hidden definitions in the
 * above sections.
 ****************************************************************************/
+char hashNoMemory;
+
 // The createHashTable is provided for you as a starting point.
-HashTable* createHashTable(HashFunction hashFunction, unsigned int numBuckets) {
-  // The hash table has to contain at least one bucket. Exit gracefully if
-  // this condition is not met.
+HashTable* createHashTable(HashFunction hashFunction, unsigned int numBuckets, int mode,
+                           const HashAllocator* allocator) {
+  // The hash table has to contain at least one bucket.
   if (numBuckets==0) {
-    printf("Hash table has to contain at least 1 bucket...\n");
-    exit(1);
+    return NULL;
+  }
+
+  // Round the bucket count up to a power of two, so a bucket index is just
+  // the low bits of the hash. Doubling and halving keep it a power of two.
+  unsigned int size = 1;
+  while(size < numBuckets) {
+    size <<= 1;
   }
+  numBuckets = size;
 
-  // Allocate memory for the new HashTable struct on heap.
-  HashTable* newTable = (HashTable*)malloc(sizeof(HashTable));
+  // Allocate memory for the new HashTable struct on heap (or from the allocator).
+  HashAllocator heap = { NULL, NULL, NULL };
+  if (allocator == NULL) {
+    allocator = &heap;
+  }
+  HashTable* newTable = (HashTable*)tableAlloc(allocator, sizeof(HashTable));
+  if (newTable == NULL) {
+    return NULL;
+  }
 
   // Initialize the components of the new HashTable struct.
   newTable->hash = hashFunction;
+  newTable->allocator = *allocator;
   newTable->num_buckets = numBuckets;
-  newTable->buckets = (HashTableEntry**)malloc(numBuckets*sizeof(HashTableEntry*));
+  newTable->min_buckets = numBuckets;
+  newTable->num_items = 0;
+  newTable->mode = mode;
+  newTable->old_buckets = NULL;
+  newTable->old_slots = NULL;
+  newTable->old_num_buckets = 0;
+  newTable->old_items = 0;
+  newTable->rehash_index = 0;
+  newTable->pool_free = NULL;
+  newTable->pool_next = NULL;
+  newTable->pool_end = NULL;
+  newTable->pool_slabs = NULL;
+  newTable->pool_capacity = 0;
+  newTable->pool_used = 0;
+  newTable->pool_high_water = 0;
+#if HASH_TABLE_STATS
+  newTable->probe_count = 0;
+  hashTableResetStats(newTable);
+#endif
 
-  // As the new buckets contain indeterminant values, init each bucket as NULL.
-  unsigned int i;
-  for (i=0; i<numBuckets; ++i) {
-    newTable->buckets[i] = NULL;
+  // An open addressing table keeps its items inline in the slot array,
+  // a chained table starts with every bucket empty.
+  if (mode == HASH_OPEN) {
+    newTable->buckets = NULL;
+    newTable->slots = createSlots(newTable, numBuckets);
+  }
+  else {
+    newTable->slots = NULL;
+    newTable->buckets = createBuckets(newTable, numBuckets);
+  }
+  if (newTable->slots == NULL && newTable->buckets == NULL) {
+    tableFree(allocator, newTable);
+    return NULL;
   }
 
   // Return the new HashTable struct.
@@ -212,30 +798,117 @@ HashTable* createHashTable(HashFunction hashFunction, unsigned int numBuckets) {
 }
 
 void destroyHashTable(HashTable* hashTable) {
+  // Move everything into one array first, so there is only one array to free
+  finishRehash(hashTable);
+
+  // The table itself is freed last, so keep its allocator
+  HashAllocator allocator = hashTable->allocator;
+
+  // An open addressing table only has to free the values and the slot array
+  if(hashTable->mode == HASH_OPEN) {
+    unsigned int i;
+    for(i = 0; i < hashTable->num_buckets; i++) {
+      if(hashTable->slots[i].dist) {
+        tableFree(&allocator, hashTable->slots[i].value);
+      }
+    }
+    tableFree(&allocator, hashTable->slots);
+    tableFree(&allocator, hashTable);
+    return;
+  }
+
   // Iterate through each bucket to free up its entries
   unsigned int i;
   for(i = 0; i < hashTable->num_buckets; i++) {
 
-    // Now iterate through the linkedlist bucket to free each HashTableEntry
+    // Now iterate through the linkedlist bucket to free each value. The
+    // entries themselves belong to the pool and are released below.
     HashTableEntry* currentEntry = hashTable->buckets[i];
-    HashTableEntry* nextEntry;
     while(currentEntry) {
-      nextEntry = currentEntry->next;
-      free(currentEntry->value);
-      free(currentEntry);
-      currentEntry = nextEntry;
+      tableFree(&allocator, currentEntry->value);
+      currentEntry = currentEntry->next;
     }
+  }
 
-    // Destroy the bucket
-    hashTable->buckets[i] = NULL;
+  // Release the whole entry pool, one free per slab. A caller supplied
+  // buffer is left to its owner.
+  EntrySlab* slab = hashTable->pool_slabs;
+  while(slab) {
+    EntrySlab* next = slab->next;
+    tableFree(&allocator, slab);
+    slab = next;
   }
 
   // Finally, free the buckets array and the table itself
-  free(hashTable->buckets);
-  free(hashTable);
+  tableFree(&allocator, hashTable->buckets);
+  tableFree(&allocator, hashTable);
+}
+
+void hashTableUseBuffer(HashTable* hashTable, void* buffer, unsigned int size) {
+  // Round the start of the buffer up to pointer alignment
+  unsigned int skip = (sizeof(void*) - (unsigned long)buffer % sizeof(void*)) % sizeof(void*);
+  if (size <= skip) {
+    return;
+  }
+  unsigned int count = (size - skip) / sizeof(HashTableEntry);
+
+  // Whatever is left of the current region goes onto the free list, so the
+  // buffer can become the new unused region
+  while (hashTable->pool_next != hashTable->pool_end) {
+    HashTableEntry* entry = hashTable->pool_next++;
+    entry->next = hashTable->pool_free;
+    hashTable->pool_free = entry;
+  }
+
+  hashTable->pool_next = (HashTableEntry*)((char*)buffer + skip);
+  hashTable->pool_end = hashTable->pool_next + count;
+  hashTable->pool_capacity += count;
+}
+
+unsigned int hashTablePoolCapacity(HashTable* hashTable) {
+  return hashTable->pool_capacity;
+}
+
+unsigned int hashTablePoolUsed(HashTable* hashTable) {
+  return hashTable->pool_used;
+}
+
+unsigned int hashTablePoolHighWater(HashTable* hashTable) {
+  return hashTable->pool_high_water;
 }
 
 void* insertItem(HashTable* hashTable, unsigned int key, void* value) {
+  // Move a few more buckets if a resize is in progress
+  if(hashTable->old_num_buckets) {
+    rehashStep(hashTable);
+  }
+
+  if(hashTable->mode == HASH_OPEN) {
+    // Overwrite the value in place if the key is already present
+    HashTableSlot* slot = findSlot(hashTable, key);
+    if(slot != NULL) {
+      void* oldValue = slot->value;
+      slot->value = value;
+      return oldValue;
+    }
+
+    // If the current array filled up before the resize could finish,
+    // finish it now so that checkLoad can start the next one
+    if(hashTable->num_items - hashTable->old_items == hashTable->num_buckets) {
+      finishRehash(hashTable);
+      checkLoad(hashTable);
+
+      // There was no memory to grow, so there is no slot for the key
+      if(hashTable->num_items == hashTable->num_buckets) {
+        return HASH_NO_MEMORY;
+      }
+    }
+    placeSlot(hashTable, key, value);
+    hashTable->num_items++;
+    checkLoad(hashTable);
+    return NULL;
+  }
+
   // First check if the item already exists, then if its value is the same.
   HashTableEntry* item = findItem(hashTable, key);
   if(item != NULL) {
@@ -245,96 +918,258 @@ void* insertItem(HashTable* hashTable, unsigned int key, void* value) {
   }
 
   // Get the bucket to insert the item into
-  unsigned int index = hashTable->hash(key);
+  unsigned int index = hashTable->hash(key) & (hashTable->num_buckets - 1);
 
   // Create the item
-  HashTableEntry* newEntry = createHashTableEntry(key, value);
+  HashTableEntry* newEntry = createHashTableEntry(hashTable, key, value);
+  if(newEntry == NULL) {
+    return HASH_NO_MEMORY;
+  }
 
   // Put it at the start of the linkedlist bucket
   newEntry->next = hashTable->buckets[index];
   hashTable->buckets[index] = newEntry;
+  hashTable->num_items++;
+  checkLoad(hashTable);
 
   // Return NULL as it is a new entry
   return NULL;
 }
 
 void* getItem(HashTable* hashTable, unsigned int key) {
-  // Find the entry
-  HashTableEntry* item = findItem(hashTable, key);
-  // If the entry exists, return its value, otherwise, return NULL
-  return (item) ? item->value : NULL;
+  // Move a few more buckets if a resize is in progress
+  if(hashTable->old_num_buckets) {
+    rehashStep(hashTable);
+  }
+
+#if HASH_TABLE_STATS
+  hashTable->probe_count = 0;
+#endif
+
+  // Find the entry or slot. If it exists, take its value, otherwise, NULL
+  void* value = NULL;
+  int found;
+  if(hashTable->mode == HASH_OPEN) {
+    HashTableSlot* slot = findSlot(hashTable, key);
+    found = (slot != NULL);
+    if(found) value = slot->value;
+  }
+  else {
+    HashTableEntry* item = findItem(hashTable, key);
+    found = (item != NULL);
+    if(found) value = item->value;
+  }
+
+#if HASH_TABLE_STATS
+  hashTable->stat_gets++;
+  hashTable->stat_hits += found;
+  hashTable->stat_probes += hashTable->probe_count;
+  if(hashTable->probe_count > hashTable->stat_max_probes) {
+    hashTable->stat_max_probes = hashTable->probe_count;
+  }
+#else
+  (void)found;
+#endif
+
+  return value;
 }
 
 void* removeItem(HashTable* hashTable, unsigned int key) {
-  // Get the head entry in the bucket
-  unsigned int index = hashTable->hash(key);
-  HashTableEntry* currentEntry = hashTable->buckets[index];
+  // Move a few more buckets if a resize is in progress
+  if(hashTable->old_num_buckets) {
+    rehashStep(hashTable);
+  }
+
+  void* value = NULL;
+  if(hashTable->mode == HASH_OPEN) {
+    HashTableSlot* slot = findSlot(hashTable, key);
+    if(slot) {
+      value = removeSlot(hashTable, slot);
+      checkLoad(hashTable);
+    }
+    return value;
+  }
 
-  // If the head doesn't exist, return NULL
-  if(!currentEntry)
+  // Find the link that points at the entry. If there is none, return NULL
+  HashTableEntry** link = findEntryLink(hashTable, key);
+  if(!link)
     return NULL;
 
-  // If the head is the item we're looking for,
-  // set the head to the next item in the linkedlist, free the old head, and return the value
-  if(currentEntry->key == key) {
-    void* temp = currentEntry->value;
-    hashTable->buckets[index] = currentEntry->next;
-    free(currentEntry);
-    return temp;
-  }
-
-  // Otherwise, iterate through the list until we find the item
-  // before the one we want to delete, then
-  // set its next pointer to skip the deleted entry, free the entry, and finally return the value
-  while(currentEntry->next) {
-    if(currentEntry->next->key == key) {
-      void* tempValue = currentEntry->next->value;
-      HashTableEntry* temp = currentEntry->next;
-      currentEntry->next = currentEntry->next->next;
-      free(temp);
-      return tempValue;
+  // Make the link skip the entry, free the entry, and return its value
+  HashTableEntry* entry = *link;
+  value = entry->value;
+  *link = entry->next;
+  destroyHashTableEntry(hashTable, entry);
+  hashTable->num_items--;
+  checkLoad(hashTable);
+  return value;
+}
+
+void deleteItem(HashTable* hashTable, unsigned int key) {
+  // Remove the entry and free the value it held. A missing key gives NULL,
+  // which tableFree ignores.
+  tableFree(&hashTable->allocator, removeItem(hashTable, key));
+}
+
+void hashTableCursorInit(HashTableCursor* cursor) {
+  cursor->phase = 0;
+  cursor->index = 0;
+  cursor->entry = NULL;
+}
+
+int hashTableNext(HashTable* hashTable, HashTableCursor* cursor, unsigned int* key, void** value) {
+  // Phase 0 walks the current array, phase 1 the old array of a resize
+  while(cursor->phase < 2) {
+    unsigned int numBuckets = (cursor->phase) ? hashTable->old_num_buckets : hashTable->num_buckets;
+
+    if(hashTable->mode == HASH_OPEN) {
+      HashTableSlot* slots = (cursor->phase) ? hashTable->old_slots : hashTable->slots;
+      while(cursor->index < numBuckets) {
+        HashTableSlot* slot = &slots[cursor->index++];
+        if(slot->dist && slot->value != MOVED) {
+          *key = slot->key;
+          *value = slot->value;
+          return 1;
+        }
+      }
     }
-    currentEntry = currentEntry->next;
+    else {
+      // Continue down the current chain, or find the next non-empty bucket
+      HashTableEntry** buckets = (cursor->phase) ? hashTable->old_buckets : hashTable->buckets;
+      HashTableEntry* entry = (HashTableEntry*)cursor->entry;
+      while(entry == NULL && cursor->index < numBuckets) {
+        entry = buckets[cursor->index++];
+      }
+      if(entry) {
+        cursor->entry = entry->next;
+        *key = entry->key;
+        *value = entry->value;
+        return 1;
+      }
+    }
+
+    cursor->phase++;
+    cursor->index = 0;
+    cursor->entry = NULL;
   }
+  return 0;
+}
 
-  //If we don't find the entry, return NULL
-  return NULL;
+/**
+ * One item copied out of the table for a key ordered walk.
+ */
+typedef struct {
+  unsigned int key;
+  void* value;
+} KeyValue;
+
+/**
+* compareKeys
+*
+* qsort comparison function that orders KeyValue items by key.
+*/
+static int compareKeys(const void* a, const void* b) {
+  unsigned int keyA = ((const KeyValue*)a)->key;
+  unsigned int keyB = ((const KeyValue*)b)->key;
+  return (keyA > keyB) - (keyA < keyB);
 }
 
-void deleteItem(HashTable* hashTable, unsigned int key) {
-  // Get the head entry in the bucket
-  unsigned int index = hashTable->hash(key);
-  HashTableEntry* currentEntry = hashTable->buckets[index];
+int hashTableForEach(HashTable* hashTable, HashTableVisitor visit, void* context, int order) {
+  HashTableCursor cursor;
+  unsigned int key;
+  void* value;
+  hashTableCursorInit(&cursor);
 
-  // If the head doesn't exist, return
-  if(!currentEntry)
-    return;
+  // Without an order, visit the items straight from the table
+  if(order != HASH_KEY_ORDER) {
+    while(hashTableNext(hashTable, &cursor, &key, &value)) {
+      if(visit(key, value, context)) {
+        break;
+      }
+    }
+    return 1;
+  }
 
-  // If the head is the item we're looking for, free its value,
-  // set the head to the next item in the linkedlist, free the old head, and return
-  if(currentEntry->key == key) {
-    free(currentEntry->value);
-    currentEntry->value = NULL;
-    hashTable->buckets[index] = currentEntry->next;
-    free(currentEntry);
-    return;
+  // Otherwise copy the items out, sort them by key, and visit the copies
+  if(hashTable->num_items == 0) {
+    return 1;
+  }
+  KeyValue* items = (KeyValue*)malloc(hashTable->num_items*sizeof(KeyValue));
+  if (items == NULL) {
+    return 0;
   }
 
+  unsigned int count = 0;
+  while(hashTableNext(hashTable, &cursor, &key, &value)) {
+    items[count].key = key;
+    items[count].value = value;
+    count++;
+  }
+  qsort(items, count, sizeof(KeyValue), compareKeys);
 
-  // Otherwise, iterate through the list until we find the item
-  // before the one we want to delete, then free its value,
-  // set its next pointer to skip the deleted entry, free the entry, and finally return
-  while(currentEntry->next) {
-    if(currentEntry->next->key == key) {
-      free(currentEntry->next->value);
-      HashTableEntry* temp = currentEntry->next;
-      currentEntry->next = currentEntry->next->next;
-      free(temp);
-      return;
+  unsigned int i;
+  for(i = 0; i < count; i++) {
+    if(visit(items[i].key, items[i].value, context)) {
+      break;
+    }
+  }
+  free(items);
+  return 1;
+}
+
+#if HASH_TABLE_STATS
+/**
+* countBin
+*
+* Helper function that adds one to histogram bin n, or to the last bin if n is
+* past the end.
+*/
+static void countBin(HashTableStats* stats, unsigned int n) {
+  stats->histogram[(n < HASH_STATS_BINS) ? n : HASH_STATS_BINS - 1]++;
+}
+
+void hashTableGetStats(HashTable* hashTable, HashTableStats* stats) {
+  unsigned int i, phase;
+
+  stats->num_items = hashTable->num_items;
+  stats->num_buckets = hashTable->num_buckets;
+  stats->load_percent = hashTable->num_items * 100 / hashTable->num_buckets;
+  for(i = 0; i < HASH_STATS_BINS; i++) {
+    stats->histogram[i] = 0;
+  }
+
+  // Both arrays of a resize in progress are still searched, so count both
+  for(phase = 0; phase < 2; phase++) {
+    unsigned int numBuckets = (phase) ? hashTable->old_num_buckets : hashTable->num_buckets;
+    for(i = 0; i < numBuckets; i++) {
+      if(hashTable->mode == HASH_OPEN) {
+        HashTableSlot* slot = (phase) ? &hashTable->old_slots[i] : &hashTable->slots[i];
+        if(slot->dist && slot->value != MOVED) {
+          countBin(stats, slot->dist - 1);
+        }
+      }
+      else {
+        unsigned int length = 0;
+        HashTableEntry* entry = (phase) ? hashTable->old_buckets[i] : hashTable->buckets[i];
+        for(; entry; entry = entry->next) {
+          length++;
+        }
+        countBin(stats, length);
+      }
     }
-    currentEntry = currentEntry->next;
   }
 
-  //If we don't find the entry, return
-  return;
+  stats->gets = hashTable->stat_gets;
+  stats->hits = hashTable->stat_hits;
+  stats->misses = hashTable->stat_gets - hashTable->stat_hits;
+  stats->probes = hashTable->stat_probes;
+  stats->max_probes = hashTable->stat_max_probes;
+}
+
+void hashTableResetStats(HashTable* hashTable) {
+  hashTable->stat_gets = 0;
+  hashTable->stat_hits = 0;
+  hashTable->stat_probes = 0;
+  hashTable->stat_max_probes = 0;
 }
+#endif
@@ -26,6 +26,9 @@
   * This defines a type that is a pointer to a function which takes
   * an unsigned int argument and returns an unsigned int value.
   * The name of the type is "HashFunction".
+  *
+  * The table uses the low bits of the value as the bucket index, so a hash
+  * function should mix every bit of the key into the whole 32-bit result.
   */
 typedef unsigned int (*HashFunction)(unsigned int key);
 
@@ -47,6 +50,51 @@ typedef struct _HashTable HashTable;
  */
 typedef struct _HashTableEntry HashTableEntry;
 
+/**
+ * Storage engines for the hash table, selected when the table is created.
+ *
+ * HASH_CHAINED keeps a singly linked list of HashTableEntry nodes in each
+ * bucket. HASH_OPEN keeps the keys and values inline in one contiguous array
+ * of slots and resolves collisions with Robin Hood linear probing, so a lookup
+ * walks neighbouring slots instead of chasing pointers around the heap.
+ */
+#define HASH_CHAINED 0
+#define HASH_OPEN    1
+
+/**
+ * HashAllocator
+ *
+ * An optional source of memory for a hash table, used in place of malloc and
+ * free for everything the table allocates: the table itself, its bucket (or
+ * slot) arrays and its entry slabs. alloc returns size bytes aligned for a
+ * pointer, or NULL if there is no memory left. release takes back a block
+ * from alloc, and is also how deleteItem and destroyHashTable free values.
+ *
+ * release may do nothing, as for an arena that is reset all at once. The
+ * owner of such an arena can then drop the whole table by resetting the arena,
+ * without calling destroyHashTable. But each resize releases the old bucket
+ * (or slot) array, so a table that resizes would then lose that memory.
+ */
+typedef struct {
+  void* (*alloc)(void* context, unsigned int size);
+  void (*release)(void* context, void* block);
+  void* context;
+} HashAllocator;
+
+/**
+ * Compile-time switch for the hash table statistics (hashTableGetStats).
+ * With HASH_TABLE_STATS set to 0 the counters, the stats functions and all
+ * of their bookkeeping are compiled out. It defaults to on, except in builds
+ * that define NDEBUG (the release profile).
+ */
+#ifndef HASH_TABLE_STATS
+#ifdef NDEBUG
+#define HASH_TABLE_STATS 0
+#else
+#define HASH_TABLE_STATS 1
+#endif
+#endif
+
 /**
  * createHashTable
  *
@@ -55,11 +103,32 @@ typedef struct _HashTableEntry HashTableEntry;
  * pointers to HashTableEntry objects based on the number of buckets available.
  * Each bucket contains a singly linked list, whose nodes are HashTableEntry objects.
  *
+ * If mode is HASH_OPEN, numBuckets is instead the initial number of inline
+ * slots.
+ *
+ * numBuckets is only the starting size. The table doubles once its load
+ * passes a threshold and halves again (never below numBuckets) once enough
+ * items are removed. Items are moved to the new array a few buckets at a time
+ * by later insertItem/getItem/removeItem/deleteItem calls, so no single call
+ * pays for the whole rehash. Because of this the table reduces the hash value
+ * to its current size itself, and myHashFunc should return a full-range value
+ * instead of reducing it to numBuckets.
+ *
+ * The bucket count is rounded up to a power of two, and the bucket index is
+ * the hash value masked to that size.
+ *
+ * If allocator is given, the table takes all of its memory from it instead
+ * of the heap, and frees values through it. It is copied into the table.
+ *
  * @param myHashFunc The pointer to the custom hash function.
  * @param numBuckets The number of buckets available in the hash table.
- * @return a pointer to the new hash table
+ * @param mode The storage engine, HASH_CHAINED (default) or HASH_OPEN.
+ * @param allocator Where the table gets its memory, or NULL (default) for the heap.
+ * @return a pointer to the new hash table, or NULL if numBuckets is 0 or
+ *         there was no memory for it
  */
-HashTable* createHashTable(HashFunction myHashFunc, unsigned int numBuckets);
+HashTable* createHashTable(HashFunction myHashFunc, unsigned int numBuckets, int mode = HASH_CHAINED,
+                           const HashAllocator* allocator = 0);
 
 /**
  * destroyHashTable
@@ -68,23 +137,37 @@ HashTable* createHashTable(HashFunction myHashFunc, unsigned int numBuckets);
  * list, the values stored on the linked list, the buckets, and the hashtable
  * itself are freed from the heap. In other words, free all the allocated memory
  * on heap that is associated with heap, including the values that users store in
- * the hash table.
+ * the hash table. The entry nodes are released together, one slab at a time.
+ * A table created with an allocator gives all of this back to it instead.
  *
  * @param myHashTable The pointer to the hash table.
  *
  */
 void destroyHashTable(HashTable* myHashTable);
 
+/**
+ * What insertItem returns when there is no memory for a new key. The value is
+ * not stored, and the table is left as it was.
+ */
+extern char hashNoMemory;
+#define HASH_NO_MEMORY ((void*)&hashNoMemory)
+
 /**
  * insertItem
  *
  * Insert the value into the hash table based on the key.
  * In other words, create a new hash table entry and add it to a specific bucket.
  *
+ * A table that has no memory to grow stays the size it is and tries again on
+ * later calls. Only when a new key cannot be stored at all (there is no memory
+ * for its entry, or every slot of a HASH_OPEN table is full) does insertItem
+ * give up, with HASH_NO_MEMORY.
+ *
  * @param myHashTable The pointer to the hash table.
  * @param key The key that corresponds to the value.
  * @param value The value to be stored in the hash table.
- * @return old value if it is overwritten, or NULL if not replaced
+ * @return old value if it is overwritten, NULL if not replaced, or
+ *         HASH_NO_MEMORY if the value could not be stored
  */
 void* insertItem(HashTable* myHashTable, unsigned int key, void* value);
 
@@ -124,4 +207,160 @@ void* removeItem(HashTable* myHashTable, unsigned int key);
  */
 void deleteItem(HashTable* myHashTable, unsigned int key);
 
+/**
+ * hashTableUseBuffer
+ *
+ * Give the table a caller-owned block of memory to carve HashTableEntry nodes
+ * from before it falls back to the heap. Entries are handed out of a per-table
+ * pool in O(1); once the buffer is used up, the pool grows by whole slabs from
+ * the heap (or the table's allocator). destroyHashTable releases the heap slabs but leaves the buffer to
+ * its owner. Only chained tables use entry nodes.
+ *
+ * @param myHashTable The pointer to the hash table.
+ * @param buffer The memory to carve entries from.
+ * @param size The size of buffer in bytes.
+ */
+void hashTableUseBuffer(HashTable* myHashTable, void* buffer, unsigned int size);
+
+/**
+ * The number of bytes a buffer for hashTableUseBuffer needs to hold n entries.
+ * An entry is a key, a value pointer and a next pointer.
+ */
+#define HASH_POOL_BYTES(n) ((n) * 3 * sizeof(void*))
+
+/**
+ * A position in a walk over the items of a hash table. Initialize it with
+ * hashTableCursorInit and advance it with hashTableNext. The members are
+ * private to the hash table module.
+ */
+typedef struct {
+  unsigned int phase;
+  unsigned int index;
+  void* entry;
+} HashTableCursor;
+
+/**
+ * hashTableCursorInit
+ *
+ * Position a cursor before the first item of any table.
+ *
+ * @param cursor The cursor to initialize.
+ */
+void hashTableCursorInit(HashTableCursor* cursor);
+
+/**
+ * hashTableNext
+ *
+ * Advance the cursor to the next occupied entry. Only occupied entries are
+ * visited, in no particular order. The table must not be changed while a
+ * cursor is walking it, and that includes getItem, which may move items while
+ * the table is resizing.
+ *
+ * @param myHashTable The pointer to the hash table.
+ * @param cursor The cursor, advanced past the returned item.
+ * @param key Set to the key of the item.
+ * @param value Set to the value of the item.
+ * @return 1 if an item was returned, 0 once every item has been visited
+ */
+int hashTableNext(HashTable* myHashTable, HashTableCursor* cursor, unsigned int* key, void** value);
+
+/**
+ * This defines a type that is a pointer to a function which is called with
+ * each item visited by hashTableForEach. It returns nonzero to stop the walk.
+ */
+typedef int (*HashTableVisitor)(unsigned int key, void* value, void* context);
+
+// Orders for hashTableForEach
+#define HASH_ANY_ORDER 0
+#define HASH_KEY_ORDER 1
+
+/**
+ * hashTableForEach
+ *
+ * Call visit for every item in the table, so a whole-table pass costs one
+ * step per item instead of one lookup per possible key. With HASH_KEY_ORDER
+ * the items are visited in increasing key order, at the cost of a temporary
+ * array of the items, from the heap, that is sorted first. The same
+ * restrictions as for hashTableNext apply to the visitor.
+ *
+ * @param myHashTable The pointer to the hash table.
+ * @param visit The function to call for each item.
+ * @param context Passed through to visit.
+ * @param order HASH_ANY_ORDER or HASH_KEY_ORDER.
+ * @return 1, or 0 if there was no memory for the HASH_KEY_ORDER array, in
+ *         which case nothing was visited
+ */
+int hashTableForEach(HashTable* myHashTable, HashTableVisitor visit, void* context, int order);
+
+#if HASH_TABLE_STATS
+/**
+ * The number of bins in the chain length histogram. The last bin counts
+ * everything at least that long.
+ */
+#define HASH_STATS_BINS 8
+
+/**
+ * A snapshot of the shape and usage of a hash table, filled by
+ * hashTableGetStats.
+ */
+typedef struct {
+  /** The number of items and buckets (slots, for HASH_OPEN) */
+  unsigned int num_items;
+  unsigned int num_buckets;
+
+  /** Items per bucket, as a percentage */
+  unsigned int load_percent;
+
+  /**
+   * For HASH_CHAINED, histogram[i] is the number of buckets holding a chain
+   * of i entries. For HASH_OPEN, it is the number of items sitting i slots
+   * away from their home slot.
+   */
+  unsigned int histogram[HASH_STATS_BINS];
+
+  /** getItem calls since the last reset, split into hits and misses */
+  unsigned int gets;
+  unsigned int hits;
+  unsigned int misses;
+
+  /** Entries (or slots) examined by those getItem calls: total and worst */
+  unsigned int probes;
+  unsigned int max_probes;
+} HashTableStats;
+
+/**
+ * hashTableGetStats
+ *
+ * Fill stats with the current shape of the table and the getItem counters.
+ * The average probe length per getItem is probes / gets.
+ *
+ * @param myHashTable The pointer to the hash table.
+ * @param stats The structure to fill.
+ */
+void hashTableGetStats(HashTable* myHashTable, HashTableStats* stats);
+
+/**
+ * hashTableResetStats
+ *
+ * Zero the getItem counters of the table.
+ *
+ * @param myHashTable The pointer to the hash table.
+ */
+void hashTableResetStats(HashTable* myHashTable);
+#endif
+
+/**
+ * hashTablePoolCapacity, hashTablePoolUsed, hashTablePoolHighWater
+ *
+ * Entry pool counters: the number of entries the pool can hold without
+ * growing, the number currently in use, and the most that were ever in use at
+ * once.
+ *
+ * @param myHashTable The pointer to the hash table.
+ * @return the counter value, in entries
+ */
+unsigned int hashTablePoolCapacity(HashTable* myHashTable);
+unsigned int hashTablePoolUsed(HashTable* myHashTable);
+unsigned int hashTablePoolHighWater(HashTable* myHashTable);
+
 #endif
@@ -0,0 +1,227 @@
+#include "lcd.h"
+
+#include "globals.h"
+#include "RawSerial.h"
+
+// Commands in the LCD's serial protocol. The LCD replies to each with one
+// byte, an ACK (or a NAK, if it did not like the command).
+#define CMD_BLIT        0x000A
+#define CMD_FILLED_RECT 0xFFCE
+
+/**
+ * The LCD's UART, the one uLCD also uses. It is made in lcd_init, after uLCD,
+ * so that the UART's interrupts come to the handlers here.
+ */
+static RawSerial* port = NULL;
+
+/**
+ * The ring buffer of command bytes. head and tail count the bytes ever queued
+ * and sent, so head - tail bytes are waiting, at index (count % size).
+ */
+static volatile unsigned char ring[LCD_QUEUE_BYTES];
+static volatile unsigned head = 0;
+static volatile unsigned tail = 0;
+
+/**
+ * The length of each queued command, so the interrupts know where commands
+ * end. cmd_head and cmd_tail count the commands ever queued and started.
+ */
+static volatile unsigned short lengths[LCD_QUEUE_COMMANDS];
+static volatile unsigned cmd_head = 0;
+static volatile unsigned cmd_tail = 0;
+
+static volatile int cmd_left = 0;         // Bytes of the current command to send
+static volatile int sending = false;      // If the transmit interrupt is on
+static volatile int awaiting_ack = false; // If the LCD has yet to reply
+static int listening = false;             // If the receive interrupt is on
+static int stalls = 0;
+
+/**
+ * Transmit interrupt: fills the UART's FIFO from the ring, up to the end of the
+ * current command, then turns itself off until the LCD replies. It also turns
+ * off if the rest of the command has not been queued yet.
+ */
+static void tx_irq()
+{
+    while (port->writeable())
+    {
+        if (!cmd_left)
+        {
+            if (cmd_tail == cmd_head) break; // Nothing queued
+            cmd_left = lengths[cmd_tail % LCD_QUEUE_COMMANDS];
+            cmd_tail++;
+        }
+        if (tail == head) break; // The command is still being queued
+
+        port->putc(ring[tail % LCD_QUEUE_BYTES]);
+        tail++;
+        if (!--cmd_left)
+        {
+            awaiting_ack = true;
+            break;
+        }
+    }
+
+    // Keep going if the FIFO is only full, else wait to be started again
+    if (port->writeable() || awaiting_ack)
+    {
+        port->attach(NULL, RawSerial::TxIrq);
+        sending = false;
+    }
+}
+
+/**
+ * Starts the transmit interrupt, and fills the FIFO now rather than waiting
+ * for it. Only call with interrupts off or from an interrupt.
+ */
+static void start_sending()
+{
+    sending = true;
+    port->attach(&tx_irq, RawSerial::TxIrq);
+    tx_irq();
+}
+
+/**
+ * Receive interrupt: the LCD's reply to a command, so the next can start.
+ */
+static void rx_irq()
+{
+    while (port->readable())
+    {
+        port->getc();
+        if (awaiting_ack)
+        {
+            awaiting_ack = false;
+            if (head != tail) start_sending();
+        }
+    }
+}
+
+/**
+ * Makes sure bytes that have been queued are going out.
+ */
+static void kick()
+{
+    __disable_irq();
+    if (!sending && !awaiting_ack && head != tail) start_sending();
+    __enable_irq();
+}
+
+/**
+ * Returns true if the queue has room for n more bytes and c more commands.
+ */
+static int room(unsigned n, unsigned c)
+{
+    return LCD_QUEUE_BYTES - (head - tail) >= n && LCD_QUEUE_COMMANDS - (cmd_head - cmd_tail) >= c;
+}
+
+/**
+ * Back-pressure: sleeps until the interrupts have made room for n more bytes
+ * and c more commands in the queue.
+ */
+static void wait_for_room(unsigned n, unsigned c)
+{
+    if (room(n, c)) return;
+    stalls++;
+    kick();
+
+    // With interrupts off, one that lands between the test and the sleep
+    // still wakes the sleep
+    __disable_irq();
+    while (!room(n, c))
+    {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+}
+
+/**
+ * Queues the start of a command of length bytes, to be followed by exactly
+ * that many bytes from put16.
+ */
+static void begin_command(int length)
+{
+    if (!listening)
+    {
+        port->attach(&rx_irq, RawSerial::RxIrq);
+        listening = true;
+    }
+    wait_for_room(0, 1);
+    lengths[cmd_head % LCD_QUEUE_COMMANDS] = length;
+    cmd_head++;
+}
+
+/**
+ * Queues a 16-bit value, most significant byte first as the LCD takes it.
+ */
+static void put16(int value)
+{
+    wait_for_room(2, 0);
+    ring[head % LCD_QUEUE_BYTES] = (value >> 8) & 0xFF;
+    ring[(head + 1) % LCD_QUEUE_BYTES] = value & 0xFF;
+    head += 2;
+}
+
+void lcd_init(int baud)
+{
+    port = new RawSerial(p9, p10);
+    port->baud(baud);
+}
+
+void lcd_blit(int x, int y, int w, int h, const unsigned short* pixels)
+{
+    begin_command(10 + 2 * w * h);
+    put16(CMD_BLIT);
+    put16(x);
+    put16(y);
+    put16(w);
+    put16(h);
+    for (int i = 0; i < w * h; i++)
+    {
+        put16(pixels[i]);
+
+        // Start sending a big BLIT before all of it is queued
+        if ((i & 63) == 63) kick();
+    }
+    kick();
+}
+
+void lcd_fill(int x0, int y0, int x1, int y1, int color)
+{
+    begin_command(12);
+    put16(CMD_FILLED_RECT);
+    put16(x0);
+    put16(y0);
+    put16(x1);
+    put16(y1);
+    put16(RGB565(color));
+    kick();
+}
+
+void lcd_fence()
+{
+    if (!port) return;
+    kick();
+    __disable_irq();
+    while (head != tail || cmd_left || awaiting_ack)
+    {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+
+    // Hand the replies back to uLCD
+    if (listening)
+    {
+        port->attach(NULL, RawSerial::RxIrq);
+        listening = false;
+    }
+}
+
+int lcd_queue_stalls()
+{
+    return stalls;
+}
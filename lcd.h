@@ -0,0 +1,60 @@
+#ifndef LCD_H
+#define LCD_H
+
+/**
+ * A queue of LCD commands, sent in the background.
+ *
+ * Tiles and fills are encoded in the LCD's serial protocol into a ring
+ * buffer, and the UART's interrupts send them on while the game carries on.
+ * Like uLCD, each command is only started once the LCD has acknowledged the
+ * one before it. When the ring is full, queueing waits for room.
+ *
+ * Everything else (text, lines, circles) still goes through uLCD, which
+ * shares the UART and waits for each reply itself. So anything that calls
+ * uLCD directly must call lcd_fence first.
+ */
+
+// Bytes of commands the ring buffer holds. A command bigger than this (a
+// wide BLIT) is fed into it as it goes out.
+#ifndef LCD_QUEUE_BYTES
+#define LCD_QUEUE_BYTES 2048
+#endif
+
+// Commands the queue holds
+#ifndef LCD_QUEUE_COMMANDS
+#define LCD_QUEUE_COMMANDS 32
+#endif
+
+// A 24-bit colour, as uLCD takes them, in the LCD's 16-bit RGB565
+#define RGB565(c) ((((c) >> 8) & 0xF800) | (((c) >> 5) & 0x07E0) | (((c) >> 3) & 0x001F))
+
+/**
+ * Takes over the LCD's UART interrupts. Call after uLCD has set the baud rate,
+ * with the same rate.
+ */
+void lcd_init(int baud);
+
+/**
+ * Queues a BLIT of a w by h block of RGB565 pixels, in row-major order, with
+ * its top left at (x,y).
+ */
+void lcd_blit(int x, int y, int w, int h, const unsigned short* pixels);
+
+/**
+ * Queues a rectangle from (x0,y0) to (x1,y1) filled with a 24-bit colour, as
+ * uLCD.filled_rectangle takes.
+ */
+void lcd_fill(int x0, int y0, int x1, int y1, int color);
+
+/**
+ * Waits until every queued command is on the screen, and hands the UART back
+ * to uLCD until the next command is queued.
+ */
+void lcd_fence();
+
+/**
+ * How many times queueing has had to wait for room since lcd_init.
+ */
+int lcd_queue_stalls();
+
+#endif // LCD_H
@@ -5,17 +5,37 @@
 #include "graphics.h"
 #include "speech.h"
 #include "maze.h"
+#include "path.h"
+#include "lcd.h"
 
 // Functions in this file
-MapItem* next_to(int x, int y, int type, int on, int erase);
 int get_action (GameInputs inputs);
 int update_game (int action);
 void draw_game (int init);
-void init_main_map ();
+int build_main_map (int step);
+int build_ruins (int step);
+void build_map (int m);
+void preload (int budget);
 int main ();
 
 // Constants
 #define NO_ACTION_LIMIT 200 // Accelerometer sensitivity limit required for movement
+
+// Map file the overworld is paged from, if there is an SD card
+#define WORLD_FILE "/sd/world.map"
+
+// Maps are built on first entry, or ahead of time while the player is within
+// PRELOAD_DISTANCE tiles of stairs leading to them
+#define NUM_MAPS 2
+#define PRELOAD_DISTANCE 6
+#define MAX_STAIRS 4 // Most stairs looked at around the player
+
+// Set to 1 to dump each map to the serial console once it is built
+#define DUMP_MAPS 0
+
+// Set to 1 to print, each frame, the cycles draw_game spends fetching map
+// tiles and what was sent to the LCD
+#define PROFILE_DRAW 0
 // NPC states
 #define START 1
 #define GO    2
@@ -38,45 +58,31 @@ static int NPC_x = 24;
 static int NPC_y = 22;
 static int state = START;
 
-// Looks for a MapItem of the given type next to the x,y
-// and returns a pointer to it.
-// If on is true, look at the tile at x,y.
-// If erase is true, erase the tile it finds.
-MapItem* next_to(int x, int y, int type, int on, int erase)
-{
-    MapItem* up    = get_north(Player.x, Player.y);
-    MapItem* left  = get_west(Player.x, Player.y);
-    MapItem* right = get_east(Player.x, Player.y);
-    MapItem* down  = get_south(Player.x, Player.y);
-    MapItem* here  = get_here(Player.x, Player.y);
-    MapItem* output = NULL; //if no tile exists, return null
-
-    if(up->type == type)
-        output = up;
-    else if(left->type == type)
-        output = left;
-    else if(right->type == type)
-        output = right;
-    else if(down->type == type)
-        output = down;
-    else if(on && here->type == type)
-        output = here;
-    // if erase is on and the tile was found
-    if(erase && output) {
-        if(up->type == type)
-            map_erase(Player.x, Player.y - 1);
-        else if(left->type == type)
-            map_erase(Player.x - 1, Player.y);
-        else if(right->type == type)
-            map_erase(Player.x + 1, Player.y);
-        else if(down->type == type)
-            map_erase(Player.x, Player.y + 1);
-        else if(here->type == type)
-            map_erase(Player.x, Player.y);
-    }
-
-    return output;
-}
+// The game's maps. Each builder call builds one step of its map (on the
+// active map) and returns true once the map is done. A map with a file is
+// paged from it if the file can be opened.
+typedef int (*MapBuilder)(int step);
+struct MapSpec {
+    int w, h;
+    MapBuilder build;
+    const char* file;
+};
+static const MapSpec map_specs[NUM_MAPS] = {
+    { 50, 50, build_main_map, WORLD_FILE },
+    { 15, 30, build_ruins,    NULL },
+};
+// Registry index of each map, or -1 until it is created
+static int map_ids[NUM_MAPS] = { -1, -1 };
+// Next build step of each map, or -1 once the map is built
+static int build_step[NUM_MAPS];
+
+// Longest frame so far, not counting the frame delay
+static int slowest_frame = 0;
+
+// The ruins maze shifts to its next layout each time the key is taken
+static const char* ruins_layouts[] = { maze1, maze2 };
+static MazeDiff ruins_diffs[2];
+static MazeChain ruins_maze;
 
 /**
  * Given the game inputs, determine what kind of update needs to happen.
@@ -114,84 +120,64 @@ int get_action(GameInputs inputs)
  * requests GO_UP, then this function should determine if that is possible by
  * consulting the map, and update the Player position accordingly.
  *
- * Return values are defined below. FULL_DRAW indicates that for this frame,
- * draw_game should not optimize drawing and should draw every tile, even if
- * the player has not moved.
+ * Return values are defined below. Nothing here needs to ask for a full
+ * redraw: draw_game redraws whatever changed on the screen, whether the player
+ * moved, the map changed, or a speech bubble covered part of the view.
  */
 #define NO_RESULT       0
 #define GAME_OVER_WIN   1
 #define GAME_OVER_LOSS  2
-#define FULL_DRAW       3
 int update_game(int action)
 {
     // Save player previous location before updating
     Player.px = Player.x;
     Player.py = Player.y;
 
-    MapItem* nextTile;
-
-    bool full_draw = false;
-
     // if the player is actually doing something, increase the npc walk counter
     if(action)
         walk_counter += 1;
 
-    // If the walk counter has reached 5 and we're in the main map, move the NPC in a random direction
-    if(walk_counter >= 5 && get_active_map() == get_map(0)) {
+    // If the walk counter has reached 5 and we're in the main map, move the NPC.
+    // Once the player has the key, the NPC comes to them; otherwise it wanders.
+    if(walk_counter >= 5 && get_active_map() == get_map(map_ids[0])) {
         pc.printf("Starting NPC move\r\n");
         // save the old NPC spot
         int NPC_px = NPC_x;
         int NPC_py = NPC_y;
-        do {
-            int dir = rand() % 5; // move in the 4 directions or stay still
-            pc.printf("Attempting to move in: %u\r\n", dir);
-            switch(dir) {
-                // move up
-                case 1:
-                    nextTile = get_north(NPC_x, NPC_y);
-                    if(!nextTile || nextTile->walkable) // move if nextTile does not exist or is walkable
-                        NPC_y -= 1;
-                    else
-                        continue;
-                    break;
-                // move right
-                case 2:
-                    nextTile = get_east(NPC_x, NPC_y);
-                    if(!nextTile || nextTile->walkable)
-                        NPC_x += 1;
-                    else
-                        continue;
-                    break;
-                // move down
-                case 3:
-                    nextTile = get_south(NPC_x, NPC_y);
-                    if(!nextTile || nextTile->walkable)
-                        NPC_y += 1;
-                    else
-                        continue;
-                    break;
-                // move left
-                case 4:
-                    nextTile = get_north(NPC_x, NPC_y);
-                    if(!nextTile || nextTile->walkable)
-                        NPC_y -= 1;
-                    else
-                        continue;
-                    break;
-                // stay still
-                default:
-                    nextTile = get_here(NPC_x, NPC_y);
-                    break;
+        // the 4 directions, in PATH_NORTH..PATH_WEST order
+        const int dx[4] = { 0, 1, 0, -1 };
+        const int dy[4] = { -1, 0, 1, 0 };
+        int dir = PATH_NONE;
+        if(Player.has_key && state == GO) {
+            dir = path_step(Player.x, Player.y, NPC_x, NPC_y);
+            // stop next to the player, not on top of them
+            if(dir != PATH_NONE && NPC_x + dx[dir] == Player.x && NPC_y + dy[dir] == Player.y)
+                dir = PATH_NONE;
+        }
+        else {
+            // pick one of the walkable directions, or stay still
+            int options[4];
+            int count = 0;
+            for(int d = 0; d < 4; d++) {
+                int nx = NPC_x + dx[d], ny = NPC_y + dy[d];
+                if(map_walkable(nx, ny) && !(nx == Player.x && ny == Player.y))
+                    options[count++] = d;
             }
-        // loop if nextTile exists and is not walkable.
-        }while(nextTile && !nextTile->walkable);
+            int pick = rand() % (count + 1);
+            if(pick < count)
+                dir = options[pick];
+        }
+        pc.printf("Moving in: %d\r\n", dir);
+        if(dir != PATH_NONE) {
+            NPC_x += dx[dir];
+            NPC_y += dy[dir];
+        }
     // Update the NPC's location
-    map_remove(NPC_px, NPC_py);
+    map_erase(NPC_px, NPC_py);
     add_NPC(NPC_x, NPC_y, &state);
     pc.printf("NPC removed and added\r\n");
-    // Finally, reset the walk counter and make sure to return a full draw
+    // Finally, reset the walk counter
     walk_counter = 0;
-    full_draw = true;
     }
 
     // Do different things based on the each action.
@@ -200,33 +186,35 @@ int update_game(int action)
     {
         case GO_UP:
             pc.printf("Up\r\n");
-            nextTile = get_north(Player.x, Player.y);
-            if(Player.omni || !nextTile || nextTile->walkable) //if omni is on or the next tile doesn't exist or the next tile is walkable
+            if(Player.omni || map_walkable(Player.x, Player.y - 1)) //if omni is on or the next tile is walkable
                 Player.y -= 1;
             break;
         case GO_LEFT:
             pc.printf("Left\r\n");
-            nextTile = get_west(Player.x, Player.y);
-            if(Player.omni || !nextTile || nextTile->walkable)
+            if(Player.omni || map_walkable(Player.x - 1, Player.y))
                 Player.x -= 1;
             break;
         case GO_DOWN:
             pc.printf("Down\r\n");
-            nextTile = get_south(Player.x, Player.y);
-            if(Player.omni || !nextTile || nextTile->walkable)
+            if(Player.omni || map_walkable(Player.x, Player.y + 1))
                 Player.y += 1;
             break;
         case GO_RIGHT:
             pc.printf("Right\r\n");
-            nextTile = get_east(Player.x, Player.y);
-            if(Player.omni || !nextTile || nextTile->walkable)
+            if(Player.omni || map_walkable(Player.x + 1, Player.y))
                 Player.x += 1;
             break;
-        case ACTION_BUTTON:
+        case ACTION_BUTTON: {
             pc.printf("Action button\r\n");
+            // Look at the tiles around the player once, for all the checks below
+            MapNeighbourhood near;
+            map_neighbours(Player.x, Player.y, &near);
+            MapCell* cell;
+
             // If you are standing next to an NPC
-            MapItem* npc = next_to(Player.x, Player.y, NPC, false, false);
-            if(npc) {
+            cell = map_find_near(&near, NPC, false);
+            if(cell) {
+                MapItem* npc = cell->item;
                 pc.printf("NPC found\r\n");
                 if (npc->data) pc.printf("NPC data: %u\r\n", *((int*)npc->data));
 
@@ -256,7 +244,7 @@ int update_game(int action)
                     // set the NPC to say the next lines
                     state = GO;
                     npc->data = &state;
-                    return FULL_DRAW;
+                    return NO_RESULT;
                 }
                 else if(npc->data && *((int*)npc->data) == GO) {
                     const char* lines[] = { "You have to get  ",
@@ -265,7 +253,7 @@ int update_game(int action)
                                             "leave this map.  "};
                     long_speech(lines, 4);
 
-                    return FULL_DRAW;
+                    return NO_RESULT;
                 }
                 else if(npc->data && *((int*)npc->data) == FOUND) {
                     const char* lines[] = { "Thank god, you   ",
@@ -281,59 +269,67 @@ int update_game(int action)
                     // set the NPC to say the next lines
                     state = END;
                     npc->data = &state;
-                    return FULL_DRAW;
+                    return NO_RESULT;
                 }
                 else if(npc->data && *((int*)npc->data) == END) {
                     const char* lines[] = { "Please, end it.  "};
                     long_speech(lines, 1);
-                    return FULL_DRAW;
+                    return NO_RESULT;
                 }
                 else {
                     const char* lines[] = { "YOU SHOULDN'T BE",
                               "HERE.           "};
                     long_speech(lines, 2);
-                    return FULL_DRAW;
+                    return NO_RESULT;
                 }
             }
 
             // If you are standing on or next to a key, take it and erase it
-            if(next_to(Player.x, Player.y, KEY, true, true)) {
+            cell = map_find_near(&near, KEY, true);
+            if(cell) {
                 pc.printf("Key found\r\n");
+                map_erase(cell->x, cell->y);
+                Player.has_key = 1;
 
-                // if you're in the ruins, swap the mazes
-                if(get_active_map() == get_map(1)) {
-                    remove_maze(2, 17, maze1);
-                    add_maze(2, 17, maze2);
+                // if you're in the ruins, shift the maze; only the cells that change are touched
+                if(get_active_map() == get_map(map_ids[1])) {
+                    maze_chain_step(&ruins_maze);
                     pc.printf("Maze shifted\r\n");
                 }
-                Player.has_key = 1;
-
-                return FULL_DRAW;
+                break;
             }
 
-            // If you are standing next to a door with a key, open it
-            MapItem* door = next_to(Player.x, Player.y, DOOR, false, false);
-            if(Player.has_key && (door)) {
+            // If you are standing next to a door with a key, open it.
+            // Doors share a prototype, so get this one its own copy first.
+            cell = map_find_near(&near, DOOR, false);
+            if(Player.has_key && cell) {
                 pc.printf("Door opened\r\n");
-                door->walkable = true;
+                MapItem* door = map_edit(cell->x, cell->y);
                 door->draw = draw_door_open;
-
-                return FULL_DRAW;
+                map_set_walkable(cell->x, cell->y, true);
+                break;
             }
 
             // If you are standing on or next to a win item, take it and win the game.
-            if(next_to(Player.x, Player.y, WIN_ITEM, true, false)) {
+            if(map_find_near(&near, WIN_ITEM, true)) {
                 pc.printf("Win item taken\r\n");
 
                 return GAME_OVER_WIN;
             }
 
             // If you are standing on or next to stairs, go to their map.
-            nextTile = next_to(Player.x, Player.y, STAIRS, true, false);
-            if(nextTile) {
+            cell = map_find_near(&near, STAIRS, true);
+            if(cell) {
                 pc.printf("Going down stairs\r\n");
-                int map_num = *((int*)nextTile->data);
-                set_active_map(map_num);
+                int map_num = *((int*)cell->item->data);
+                if(build_step[map_num] < 0)
+                    pc.printf("Preload hit for map %d\r\n", map_num);
+                else {
+                    Timer bt; bt.start();
+                    build_map(map_num);
+                    pc.printf("Preload miss for map %d: built in %d ms\r\n", map_num, bt.read_ms());
+                }
+                set_active_map(map_ids[map_num]);
                 if(map_num == 1) {
                     Player.x = 7;
                     Player.y = 28;
@@ -344,11 +340,17 @@ int update_game(int action)
                 }
                 else
                     Player.x = Player.y = 25; // just in case
-                return FULL_DRAW;
+                return NO_RESULT;
             }
             break;
+        }
         case MENU_BUTTON:
             pc.printf("Menu button\r\n");
+            print_map_stats();
+            print_memory_report();
+            print_hash_report();
+            pc.printf("Slowest frame: %d ms\r\n", slowest_frame);
+            pc.printf("LCD queue stalls: %d\r\n", lcd_queue_stalls());
             break;
         case OMNI_BUTTON:
             pc.printf("Omnipotent Mode activated/deactivated: %d\r\n", !Player.omni);
@@ -357,141 +359,215 @@ int update_game(int action)
         default:
             break;
     }
-    if(full_draw)
-        return FULL_DRAW;
     return NO_RESULT;
 }
 
 /**
  * Entry point for frame drawing. This should be called once per iteration of
- * the game loop. This draws all tiles on the screen, followed by the status 
- * bars. Unless init is nonzero, this function will optimize drawing by only 
- * drawing tiles that have changed from the previous frame.
+ * the game loop. This draws the status bars, then works out what belongs in
+ * every tile on the screen, and sends only what differs from the screen
+ * shadow (see draw_cell). The tiles are queued (see lcd.h), and go out to
+ * the LCD in the background. If init is nonzero, nothing on the screen is
+ * trusted and everything is drawn.
  */
 void draw_game(int init)
 {
-    // Draw game border first
-    if(init) draw_border();
-    
-    // Iterate over all visible map tiles
-    for (int i = -5; i <= 5; i++) // Iterate over columns of tiles
+    if (init) forget_screen(0, 0, 127, 127);
+
+    // Draw game border first, then the status bars. Their text and lines go
+    // straight to uLCD, which waits for the queue to empty, so they go before
+    // the tiles: the tiles can then go out while the next frame is worked out.
+    draw_border();
+    draw_upper_status(Player.x, Player.y);
+    draw_lower_status(Player.has_key);
+
+#if PROFILE_DRAW
+    unsigned start = DWT->CYCCNT;
+#endif
+
+    // Fetch the visible tiles around the player, one row-wise pass
+    MapItem* view[VIEW_W * VIEW_H];
+    map_get_rect(Player.x - 5, Player.y - 4, VIEW_W, VIEW_H, view);
+    int w = map_width();
+    int h = map_height();
+
+#if PROFILE_DRAW
+    unsigned fetch = DWT->CYCCNT - start;
+#endif
+
+    // Iterate over all visible map tiles, a row at a time so that draw_cell
+    // can send each run of changed tiles across a row together
+    for (int j = -4; j <= 4; j++) // Iterate over rows of tiles
     {
-        for (int j = -4; j <= 4; j++) // Iterate over one column of tiles
+        for (int i = -5; i <= 5; i++) // Iterate over one row of tiles
         {
             // Here, we have a given (i,j)
             
             // Compute the current map (x,y) of this tile
             int x = i + Player.x;
             int y = j + Player.y;
-            
-            // Compute the previous map (px, py) of this tile
-            int px = i + Player.px;
-            int py = j + Player.py;
-                        
-            // Compute u,v coordinates for drawing
-            int u = (i+5)*11 + 3;
-            int v = (j+4)*11 + 15;
-            
-            // Figure out what to draw
-            DrawFunc draw = NULL;
-            if (init && i == 0 && j == 0) // Only draw the player on init
+
+            // Figure out what belongs here
+            DrawFunc draw;
+            if (i == 0 && j == 0) // The player
             {
-                draw_player(u, v, Player.has_key);
-                continue;
+                draw = (Player.has_key) ? draw_player_key : draw_player_plain;
             }
-            else if (x >= 0 && y >= 0 && x < map_width() && y < map_height() && (i != 0 || j != 0)) // Current (i,j) in the map
+            else if (x >= 0 && y >= 0 && x < w && y < h) // Current (i,j) in the map
             {
-                MapItem* curr_item = get_here(x, y);
-                MapItem* prev_item = get_here(px, py);
-                if (init || curr_item != prev_item) // Only draw if they're different
-                {
-                    if (curr_item) // There's something here! Draw it
-                    {
-                        draw = curr_item->draw;
-                    }
-                    else // There used to be something, but now there isn't
-                    {
-                        draw = draw_nothing;
-                    }
-                }
+                MapItem* item = view[(j+4)*VIEW_W + (i+5)];
+                draw = (item) ? item->draw : draw_nothing;
             }
-            else if (init) // If doing a full draw, but we're out of bounds, draw the walls.
+            else // Out of bounds, draw the walls
             {
                 draw = draw_wall;
             }
 
-            // Actually draw the tile
-            if (draw) draw(u, v);
+            // Draw the tile, if it is not already on screen
+            draw_cell(i+5, j+4, draw);
         }
     }
+    flush_cells();
+
+#if PROFILE_DRAW
+    pc.printf("draw_game: %u cycles fetching %d tiles, sent %d tiles in %d commands, %d bytes\r\n",
+              fetch, VIEW_W * VIEW_H, lcd_tiles_sent, lcd_commands_sent, lcd_bytes_sent);
+#endif
+    lcd_tiles_sent = 0;
+    lcd_commands_sent = 0;
+    lcd_bytes_sent = 0;
+}
+
+
+/**
+ * Build one step of the main world map. Add walls around the edges, interior
+ * chambers, and plants in the background so you can see motion.
+ * Returns true once the map is done.
+ */
+int build_main_map(int step)
+{
+    switch(step) {
+        case 0:
+            // "Random" plants
+            for(int i = map_width() + 3; i < map_area(); i += 39)
+            {
+                // Make sure there are no plants in the building
+                if(!(i % map_width() > 16 && i % map_width() < 35 && i / map_width() > 27 && i / map_width() < 40))
+                    add_plant(i % map_width(), i / map_width());
+            }
+            pc.printf("plants on main\r\n");
+            return false;
+        case 1:
+            pc.printf("Adding walls!\r\n");
+            add_wall_rect(0,         0,              map_width(), map_height());
+            // Player building
+            add_wall(23,            23,              HORIZONTAL, 2);
+            add_wall(23,            24,              VERTICAL,   4);
+            add_wall(26,            23,              HORIZONTAL, 2);
+            add_wall(27,            24,              VERTICAL,   4);
+            add_wall(24,            27,              HORIZONTAL, 3);
+            // Throne building
+            add_wall(16,            27,              HORIZONTAL, 7);
+            add_wall(28,            27,              HORIZONTAL, 7);
+            add_wall(16,            28,              VERTICAL,   12);
+            add_wall(35,            27,              VERTICAL,   13);
+            add_wall(16,            40,              HORIZONTAL, 20);
+            pc.printf("Walls done on main!\r\n");
+            return false;
+        default:
+            add_NPC(24, 22, &state);
+            //add_key(24, 20);
+            add_door(25, 40, 0);
+            add_win_item(25, 33);
+            static int map2 = 1;
+            add_stairs(22, 26, &map2);
+            pc.printf("NPC, key, and door added on main\r\n");
+            return true;
+    }
+}
 
-    // Draw status bars
-    draw_upper_status(Player.x, Player.y);
-    draw_lower_status(Player.has_key);
+/**
+ * Build one step of the ruins: the outer walls, then the maze, stairs and key.
+ * Returns true once the map is done.
+ */
+int build_ruins(int step)
+{
+    switch(step) {
+        case 0:
+            add_wall_rect(0,         0,              map_width(), map_height());
+            return false;
+        default:
+            add_wall(1,              17,             HORIZONTAL, 1);
+            add_wall(13,             17,             HORIZONTAL, 1);
+            add_wall(13,             28,             HORIZONTAL, 1);
+            add_wall(1,              28,             HORIZONTAL, 1);
+            maze_chain_init(&ruins_maze, 2, 17, ruins_layouts, 2, ruins_diffs);
+            static int map1 = 0;
+            add_stairs(7, 28, &map1);
+            add_key(7,3);
+            return true;
+    }
 }
 
+/**
+ * Run the next build step of map m, with m as the active map for the step.
+ * The first step creates the map. Returns true once map m is built.
+ */
+int build_map_step(int m)
+{
+    if(build_step[m] < 0) return true;
+
+    const MapSpec* spec = &map_specs[m];
+    if(map_ids[m] < 0) {
+        // Page the map through its file if it has one, or else keep it in RAM
+        if(spec->file)
+            map_ids[m] = map_create_paged(spec->w, spec->h, spec->file);
+        if(map_ids[m] >= 0)
+            pc.printf("Map %d paged from %s\r\n", m, spec->file);
+        else
+            map_ids[m] = map_create(spec->w, spec->h);
+        ASSERT_P(map_ids[m] >= 0, ERROR_MEH);
+    }
+
+    int active = get_active_map_index();
+    set_active_map(map_ids[m]);
+    int done = spec->build(build_step[m]++);
+    if(done) {
+        build_step[m] = -1;
+#if DUMP_MAPS
+        print_map();
+#endif
+    }
+    set_active_map(active);
+    return done;
+}
 
 /**
- * Initialize the main world map. Add walls around the edges, interior chambers,
- * and plants in the background so you can see motion.
+ * Finish building map m.
  */
-void init_main_map()
+void build_map(int m)
 {
-    // Create ruins
-    Map* map = set_active_map(1);
-    add_wall(0,              0,              HORIZONTAL, map_width());
-    add_wall(0,              map_height()-1, HORIZONTAL, map_width());
-    add_wall(0,              0,              VERTICAL,   map_height());
-    add_wall(map_width()-1,  0,              VERTICAL,   map_height());
-    add_wall(1,              17,             HORIZONTAL, 1);
-    add_wall(13,             17,             HORIZONTAL, 1);
-    add_wall(13,             28,             HORIZONTAL, 1);
-    add_wall(1,              28,             HORIZONTAL, 1);
-    add_maze(2, 17, maze1);
-    static int map1 = 0;
-    add_stairs(7, 28, &map1);
-    add_key(7,3);
-    print_map();
-
-    // "Random" plants
-    map = set_active_map(0);
-    for(int i = map_width() + 3; i < map_area(); i += 39)
-    {
-        // Make sure there are no plants in the building
-        if(!(i % map_width() > 16 && i % map_width() < 35 && i / map_width() > 27 && i / map_width() < 40))
-            add_plant(i % map_width(), i / map_width());
+    while(!build_map_step(m));
+}
+
+/**
+ * Use up to budget ms of idle time to build the maps that stairs near the
+ * player lead to, so that taking them does not stall the game.
+ */
+void preload(int budget)
+{
+    Timer t; t.start();
+    // Stairs in the square around the player, from the map's type index
+    MapCell near[MAX_STAIRS];
+    int n = map_find_in_rect(STAIRS, Player.x - PRELOAD_DISTANCE, Player.y - PRELOAD_DISTANCE,
+                             2 * PRELOAD_DISTANCE + 1, 2 * PRELOAD_DISTANCE + 1, near, MAX_STAIRS);
+    if(n > MAX_STAIRS) n = MAX_STAIRS;
+    for(int i = 0; i < n; i++) {
+        int to = *((int*)near[i].item->data);
+        if(build_step[to] < 0) continue;
+        if(abs(Player.x - near[i].x) + abs(Player.y - near[i].y) > PRELOAD_DISTANCE) continue;
+        while(t.read_ms() < budget && !build_map_step(to));
     }
-    pc.printf("plants on main\r\n");
-
-    pc.printf("Adding walls!\r\n");
-    add_wall(0,              0,              HORIZONTAL, map_width());
-    add_wall(0,              map_height()-1, HORIZONTAL, map_width());
-    add_wall(0,              0,              VERTICAL,   map_height());
-    add_wall(map_width()-1,  0,              VERTICAL,   map_height());
-    // Player building
-    add_wall(23,            23,              HORIZONTAL, 2);
-    add_wall(23,            24,              VERTICAL,   4);
-    add_wall(26,            23,              HORIZONTAL, 2);
-    add_wall(27,            24,              VERTICAL,   4);
-    add_wall(24,            27,              HORIZONTAL, 3);
-    // Throne building
-    add_wall(16,            27,              HORIZONTAL, 7);
-    add_wall(28,            27,              HORIZONTAL, 7);
-    add_wall(16,            28,              VERTICAL,   12);
-    add_wall(35,            27,              VERTICAL,   13);
-    add_wall(16,            40,              HORIZONTAL, 20);
-
-    pc.printf("Walls done on main!\r\n");
-
-    add_NPC(24, 22, &state);
-    //add_key(24, 20);
-    add_door(25, 40, 0);
-    add_win_item(25, 33);
-    static int map2 = 1;
-    add_stairs(22, 26, &map2);
-    pc.printf("NPC, key, and door added on main\r\n");
-
-    print_map();
 }
 
 /**
@@ -505,17 +581,31 @@ int main()
     // First things first: initialize hardware
     ASSERT_P(hardware_init() == ERROR_NONE, "Hardware init failed!");
 
-    // Initialize the maps
+#if PROFILE_DRAW
+    // Start the cycle counter used for profiling
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    Timer boot; boot.start();
+
+    // Initialize the maps. Only the overworld is built now; the others are
+    // built on first entry, or preloaded.
     maps_init();
-    init_main_map();
+    build_map(0);
+    map_sync();
+    print_memory_report();
 
     // Initialize game state
-    set_active_map(0);
+    set_active_map(map_ids[0]);
     Player.x = Player.y = 25;
     Player.has_key = 0;
 
     GameInputs in;
 
+    pc.printf("Boot: %d ms to start page\r\n", boot.read_ms());
+
     // Draw start page
     draw_start_page();
 
@@ -550,9 +640,11 @@ int main()
         // 4. Draw frame (draw_game)
         draw_game(result);
 
-        // 5. Frame delay
-        t.stop();
+        // 5. Frame delay, spending the idle time on preloading maps
         int dt = t.read_ms();
+        if (dt > slowest_frame) slowest_frame = dt;
+        if (dt < 100) preload(100 - dt);
+        dt = t.read_ms();
         if (dt < 100) wait_ms(100 - dt);
     }
 }
@@ -3,103 +3,932 @@
 #include "globals.h"
 #include "graphics.h"
 
-#define MAP_WIDTH 50
-#define MAP_HEIGHT 50
-#define NUM_TILES MAP_WIDTH*MAP_HEIGHT
+#include <malloc.h>
 
 /**
- * The Map structure. This holds a HashTable for all the MapItems, along with
- * values for the width and height of the Map.
+ * A bump allocator over the rest of a map's block of memory. Nothing in an
+ * arena is freed on its own; it all goes when the block does.
+ */
+typedef struct {
+    char* next;  // First free byte
+    char* end;   // End of the block
+    char* high;  // Furthest next has reached
+} Arena;
+
+/**
+ * The type index. Every item of an indexed type is on a list for its type and
+ * the INDEX_CELL x INDEX_CELL cell of the map it is in, so finding items of a
+ * type only looks at the cells that could hold them, not at every tile. Walls
+ * and plants are terrain, far too many to index (the walkability bitset covers
+ * what the game asks of them), so the index starts at NPC.
+ */
+#define INDEX_BITS  4
+#define INDEX_CELL  (1 << INDEX_BITS)
+#define INDEX_FIRST NPC
+#define INDEX_TYPES (WIN_ITEM - NPC + 1)
+#define INDEXED(type) ((type) >= INDEX_FIRST && (type) < INDEX_FIRST + INDEX_TYPES)
+#define NO_TYPE     -1
+
+/**
+ * The header of a block that a map's overlay table has from its arena (see
+ * arena_hash_alloc).
+ */
+typedef struct HashBlock {
+    unsigned size;           // Bytes after the header
+    struct HashBlock* next;  // Next released block, while it is on the free list
+} HashBlock;
+
+typedef struct IndexNode {
+    unsigned short x, y;
+    struct IndexNode* next;
+} IndexNode;
+
+/**
+ * One flip of a bit of the walkability bitset, for map_walk_changes: the tile,
+ * and the walk_gen stamp the flip gave the map.
+ */
+typedef struct {
+    unsigned short x, y;
+    unsigned gen;
+} WalkChange;
+
+// Flips of the walkability bitset each map remembers
+#define WALK_LOG 16
+
+/**
+ * The Map structure. This holds the tile IDs for the stateless content of the
+ * map, a HashTable overlay for the MapItems that need their own storage, along
+ * with values for the width and height of the Map.
+ *
+ * The tile IDs are either a dense grid in RAM (tiles), or, for a map made with
+ * map_create_paged, CHUNK_SIZE x CHUNK_SIZE chunks paged in and out of the map
+ * file on demand (chunks, file), with no grid at all. The overlay is always in
+ * RAM.
+ *
+ * walk mirrors the walkable flag of every tile as one bit, so collision checks
+ * are one word load and a mask. Each row is walk_stride 32-bit words; bit
+ * (x % 32) of word x / 32 is set if tile x is walkable. The bits past the
+ * width of the map are clear. walk_gen changes whenever a bit does, so
+ * anything computed from the bitset (like a flow field) can tell it is stale.
+ * walk_log holds the last WALK_LOG tiles whose bit flipped, so that it can
+ * catch up by looking at just those tiles instead of the whole bitset. Flips
+ * up to walk_floor have been pushed out of the log.
+ *
+ * index holds the heads of the type index lists, INDEX_TYPES blocks of
+ * index_cw * index_ch cells each (see index_list).
+ *
+ * A map is one block of memory: this struct followed by its arena, which holds
+ * the tile grid (or the chunk table), the walkability bitset, the type index, the overlay HashTable
+ * with its buckets and entries, and the overlay MapItems. Destroying a map gives
+ * up the block in one step.
  */
 struct Map {
+    Arena arena;
+    MapItem* free_items;     // Released overlay items, linked through data
+    HashBlock* free_blocks;  // Blocks the overlay table released
+    unsigned char* tiles;    // Dense grid, or NULL when paged
+    unsigned char** chunks;  // Resident chunk of each chunk index, or NULL if not paged
+    FILE* file;              // Map file the chunks page from, or NULL
+    int cw, ch;              // Size in chunks
+    unsigned page_ins, page_outs;
+    unsigned* walk;          // Walkability bitset
+    int walk_stride;         // Words per row of walk
+    unsigned walk_gen;       // Stamp of the last change to walk
+    WalkChange walk_log[WALK_LOG]; // Ring of the last flips of walk
+    unsigned walk_logged;    // Flips logged ever; the next goes in slot walk_logged % WALK_LOG
+    unsigned walk_floor;     // Stamp of the last flip no longer in walk_log
+    IndexNode** index;       // Type index lists
+    int index_cw, index_ch;  // Size of the index in cells
+    int index_count[INDEX_TYPES];
+    IndexNode* free_nodes;   // Released index nodes
     HashTable* items;
     int w, h;
 };
 
 /**
- * Storage area for the maps.
- * This is a global variable, but can only be access from this file because it
- * is static.
+ * Tile IDs for the dense grid. A stateless tile costs one byte and shares the
+ * prototype MapItem for its ID. TILE_OVERLAY means the MapItem for the tile
+ * has its own allocation in the items HashTable, either because it carries
+ * data (NPCs, stairs) or because it was copied by map_edit.
+ */
+#define TILE_EMPTY       0
+#define TILE_WALL        1
+#define TILE_PLANT       2
+#define TILE_KEY         3
+#define TILE_DOOR_CLOSED 4
+#define TILE_DOOR_OPEN   5
+#define TILE_WIN_ITEM    6
+#define TILE_OVERLAY     0xFF
+
+/**
+ * The prototype MapItems, one per stateless tile ID and indexed by it. They
+ * are const, so they are placed in flash, and every tile of a kind points at
+ * the same one. get_here and friends return them as plain MapItem pointers,
+ * so use map_edit to get a tile that is safe to change.
+ */
+static const MapItem prototypes[] = {
+    { 0,        NULL,             true,  NULL }, // TILE_EMPTY, never returned
+    { WALL,     draw_wall,        false, NULL }, // TILE_WALL
+    { PLANT,    draw_plant,       true,  NULL }, // TILE_PLANT
+    { KEY,      draw_key,         true,  NULL }, // TILE_KEY
+    { DOOR,     draw_door_closed, false, NULL }, // TILE_DOOR_CLOSED
+    { DOOR,     draw_door_open,   true,  NULL }, // TILE_DOOR_OPEN
+    { WIN_ITEM, draw_win_item,    true,  NULL }, // TILE_WIN_ITEM
+};
+
+/**
+ * The map registry. Maps are created with map_create, which hands out the
+ * lowest free index, and live until map_destroy. The active map is cached as
+ * a pointer, so the accessors do not look it up on every call.
+ * These are global variables, but can only be access from this file because
+ * they are static.
+ */
+#define MAX_MAPS 8
+static Map* maps[MAX_MAPS];
+static Map* active;
+static int active_map = -1;
+
+// Counts walkability changes across all maps, for Map::walk_gen. A map that
+// reuses a destroyed map's memory still gets stamps no one has seen.
+static unsigned walk_clock = 0;
+
+/**
+ * Map blocks are placed in the AHB SRAM bank, which is otherwise unused, so
+ * maps cost no main SRAM; a map that does not fit there comes from the heap.
+ * Each block has room for the tile grid (or chunk table), the walkability
+ * bitset and the type index, plus MAP_ARENA_BYTES for the overlay. The overlay
+ * is mostly pointers, so that is counted in pointers: 2 KB on the board, room
+ * for a few dozen overlay items and the table growing to hold them.
+ */
+#define OVERLAY_BUCKETS  8
+#define MAP_POOL_ENTRIES 16
+#define MAP_ARENA_BYTES  (512 * sizeof(void*))
+#define MAP_BANK_BYTES   (14 * 1024)
+static char map_bank[MAP_BANK_BYTES] __attribute__((section("AHBSRAM0")));
+
+/**
+ * Chunk paging. The chunks of every paged map share RESIDENT_CHUNKS frames;
+ * a chunk that is needed when all of them are in use replaces the least
+ * recently used one, which is written back to its file first if it changed.
+ * The frames live in the second AHB SRAM bank, so paging costs no main SRAM.
+ */
+#define CHUNK_BITS      4
+#define CHUNK_SIZE      (1 << CHUNK_BITS)
+#define CHUNK_TILES     (CHUNK_SIZE * CHUNK_SIZE)
+#define RESIDENT_CHUNKS 6
+
+typedef struct {
+    unsigned char tiles[CHUNK_TILES]; // First, so a chunk pointer is its frame
+    Map* map;                         // Owner, or NULL if the frame is free
+    int chunk;                        // Chunk index within the owner
+    unsigned stamp;                   // Time of last use
+    int dirty;                        // Changed since it was paged in
+} ChunkFrame;
+
+static ChunkFrame frames[RESIDENT_CHUNKS] __attribute__((section("AHBSRAM1")));
+static unsigned chunk_clock;
+
+/**
+ * A map file is this header followed by the chunks in index order (row-major
+ * in chunks), CHUNK_TILES tile IDs each, the tiles of a chunk row-major too.
+ * It never holds TILE_OVERLAY: the overlay items are not saved.
  */
-static Map map;
-static Map ruins;
-static int active_map;
+#define MAP_FILE_MAGIC 0x50414D52 // "RMAP"
+typedef struct {
+    unsigned magic;
+    unsigned short w, h;
+} MapFileHeader;
 
 /**
  * The first step in HashTable access for the map is turning the two-dimensional
  * key information (x, y) into a one-dimensional unsigned integer.
  * This function should uniquely map (x,y) onto the space of unsigned integers.
+ *
+ * x goes in the upper 16 bits and y in the lower 16, so the key of a tile does
+ * not depend on the size of its map (or on which map is active).
  */
 static unsigned XY_KEY(int X, int Y) {
-    // Map it to the number as if each tile of the map were numbered
-    // going across from the top left and then down
-    unsigned mapped = Y * map_width() + X;
-    return mapped;
+    return ((unsigned) X << 16) | ((unsigned) Y & 0xFFFF);
+}
+
+/**
+ * Candidate hash functions for the packed keys. The table masks the hash to
+ * its bucket count, so only the low bits pick the bucket; print_hash_report
+ * shows how evenly each one spreads the tiles of a map.
+ */
+static unsigned hash_identity(unsigned key)
+{
+    // The low bits are just y: every column lands in the same buckets
+    return key;
+}
+
+static unsigned hash_row_major(unsigned key)
+{
+    // x * 31 + y, the usual row-major style combination
+    return (key >> 16) * 31 + (key & 0xFFFF);
+}
+
+static unsigned hash_fibonacci(unsigned key)
+{
+    // Multiply by 2^32 / golden ratio, then fold the well-mixed high bits down
+    unsigned h = key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static unsigned hash_murmur(unsigned key)
+{
+    // The MurmurHash3 finalizer: every key bit affects every hash bit
+    key ^= key >> 16;
+    key *= 0x85ebca6b;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35;
+    key ^= key >> 16;
+    return key;
 }
 
+static const struct {
+    const char* name;
+    HashFunction hash;
+} candidate_hashes[] = {
+    { "identity",  hash_identity },
+    { "row-major", hash_row_major },
+    { "fibonacci", hash_fibonacci },
+    { "murmur",    hash_murmur },
+};
+#define NUM_CANDIDATE_HASHES (int)(sizeof(candidate_hashes) / sizeof(candidate_hashes[0]))
+
 /**
  * This is the hash function actually passed into createHashTable. It takes an
- * unsigned key (the output of XY_KEY) and turns it into a hash value (some
- * small non-negative integer).
+ * unsigned key (the output of XY_KEY) and turns it into a full-range hash
+ * value, which the table masks down to its own (growing) bucket count.
  */
 unsigned map_hash(unsigned key)
 {
-    unsigned hash_value = key % (map_width());
-    return hash_value;
+    return hash_murmur(key);
 }
 
 void maps_init()
 {
-    // Initialize hash table
-    map.items = createHashTable(map_hash, MAP_HEIGHT);
-    ruins.items = createHashTable(map_hash, 30);
-    // Set width & height
-    map.w = MAP_WIDTH;
-    map.h = MAP_HEIGHT;
-    ruins.w = 15;
-    ruins.h = 30;
+    for (int i = 0; i < MAX_MAPS; i++)
+        maps[i] = NULL;
+    active = NULL;
+    active_map = -1;
+    // AHB SRAM is not cleared at startup
+    memset(frames, 0, sizeof(frames));
 }
 
-Map* get_active_map()
+/**
+ * Returns size bytes from arena a, aligned for a pointer, or NULL if it is full.
+ */
+static void* arena_alloc(Arena* a, unsigned size)
+{
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    if (size > (unsigned) (a->end - a->next)) return NULL;
+    void* p = a->next;
+    a->next += size;
+    if (a->next > a->high) a->high = a->next;
+    return p;
+}
+
+/**
+ * The HashAllocator functions for a map's overlay table. The table releases
+ * its old bucket array each time it grows or shrinks, so released blocks go on
+ * the map's free list, and a request takes the smallest one there that is big
+ * enough before it takes more of the arena. The arrays double and halve, so a
+ * table that grows and shrinks keeps reusing the same few blocks rather than
+ * filling the arena with old ones.
+ */
+static void* arena_hash_alloc(void* map, unsigned int size)
 {
-    if(active_map == 0)
-        return &map;
-    else if(active_map == 1)
-        return &ruins;
+    Map* m = (Map*) map;
+    HashBlock** best = NULL;
+    for (HashBlock** link = &m->free_blocks; *link; link = &(*link)->next)
+        if ((*link)->size >= size && (!best || (*link)->size < (*best)->size))
+            best = link;
+
+    HashBlock* block;
+    if (best)
+    {
+        block = *best;
+        *best = block->next;
+    }
     else
-        return &map; //default to map
+    {
+        block = (HashBlock*) arena_alloc(&m->arena, sizeof(HashBlock) + size);
+        if (!block) return NULL;
+        block->size = size;
+    }
+    return block + 1;
 }
 
-Map* set_active_map(int m)
+static void arena_hash_release(void* map, void* p)
+{
+    Map* m = (Map*) map;
+    HashBlock* block = (HashBlock*) p - 1;
+    block->next = m->free_blocks;
+    m->free_blocks = block;
+}
+
+/**
+ * Returns true if map m was placed in the AHB SRAM bank.
+ */
+static int in_bank(Map* m)
+{
+    return (char*) m >= map_bank && (char*) m < map_bank + MAP_BANK_BYTES;
+}
+
+/**
+ * Finds size bytes of the AHB SRAM bank that no map is using, or returns NULL.
+ * This tries the start of the bank and then the end of each map block there
+ * that is in the way, so it takes the first gap that fits.
+ */
+static void* bank_take(unsigned size)
+{
+    unsigned start = 0;
+    while (start + size <= MAP_BANK_BYTES)
+    {
+        Map* clash = NULL;
+        for (int i = 0; i < MAX_MAPS && !clash; i++)
+        {
+            Map* m = maps[i];
+            if (m && in_bank(m) && (char*) m < map_bank + start + size && m->arena.end > map_bank + start)
+                clash = m;
+        }
+        if (!clash) return map_bank + start;
+        start = clash->arena.end - map_bank;
+    }
+    return NULL;
+}
+
+/**
+ * Sets every tile of map m's walkability bitset to walkable.
+ */
+static void clear_walk(Map* m)
+{
+    m->walk_gen = ++walk_clock;
+    m->walk_floor = m->walk_gen;
+    m->walk_logged = 0;
+    for (int y = 0; y < m->h; y++)
+    {
+        unsigned* row = m->walk + y * m->walk_stride;
+        for (int i = 0; i < m->walk_stride; i++)
+            row[i] = 0xFFFFFFFF;
+        // Keep the bits past the width clear
+        if (m->w & 31) row[m->walk_stride - 1] = (1u << (m->w & 31)) - 1;
+    }
+}
+
+/**
+ * Stamps map m's walkability bitset as changed by the bit of (x,y) flipping,
+ * and logs the flip.
+ */
+static void log_walk(Map* m, int x, int y)
+{
+    m->walk_gen = ++walk_clock;
+    WalkChange* c = &m->walk_log[m->walk_logged % WALK_LOG];
+    if (m->walk_logged >= WALK_LOG) m->walk_floor = c->gen;
+    m->walk_logged++;
+    c->x = x;
+    c->y = y;
+    c->gen = m->walk_gen;
+}
+
+/**
+ * Records in map m's walkability bitset whether (x,y) is walkable. (x,y) must
+ * be on the map.
+ */
+static void set_walk(Map* m, int x, int y, int walkable)
+{
+    unsigned* word = &m->walk[y * m->walk_stride + (x >> 5)];
+    unsigned old = *word;
+    if (walkable) *word |= 1u << (x & 31);
+    else *word &= ~(1u << (x & 31));
+    if (*word != old) log_walk(m, x, y);
+}
+
+/**
+ * Empties map m's type index, sized to the map. The nodes are kept for reuse.
+ */
+static void clear_index(Map* m)
+{
+    m->index_cw = (m->w + INDEX_CELL - 1) >> INDEX_BITS;
+    m->index_ch = (m->h + INDEX_CELL - 1) >> INDEX_BITS;
+    int n = INDEX_TYPES * m->index_cw * m->index_ch;
+    for (int i = 0; i < n; i++)
+    {
+        while (m->index[i])
+        {
+            IndexNode* node = m->index[i];
+            m->index[i] = node->next;
+            node->next = m->free_nodes;
+            m->free_nodes = node;
+        }
+    }
+    for (int t = 0; t < INDEX_TYPES; t++)
+        m->index_count[t] = 0;
+}
+
+/**
+ * Returns the head of the index list for the given type in cell (cx,cy) of
+ * map m. type must be INDEXED.
+ */
+static IndexNode** index_list(Map* m, int type, int cx, int cy)
+{
+    int cells = m->index_cw * m->index_ch;
+    return &m->index[(type - INDEX_FIRST) * cells + cy * m->index_cw + cx];
+}
+
+/**
+ * Records in map m's type index that the item at (x,y) changed from type from
+ * to type to. Either can be NO_TYPE, or a type that is not indexed.
+ */
+static void index_move(Map* m, int x, int y, int from, int to)
+{
+    if (from == to) return;
+    if (INDEXED(from))
+    {
+        IndexNode** link = index_list(m, from, x >> INDEX_BITS, y >> INDEX_BITS);
+        while (*link && ((*link)->x != x || (*link)->y != y))
+            link = &(*link)->next;
+        IndexNode* node = *link;
+        if (node)
+        {
+            *link = node->next;
+            node->next = m->free_nodes;
+            m->free_nodes = node;
+            m->index_count[from - INDEX_FIRST]--;
+        }
+    }
+    if (INDEXED(to))
+    {
+        IndexNode* node = m->free_nodes;
+        if (node)
+            m->free_nodes = node->next;
+        else
+            node = (IndexNode*) arena_alloc(&m->arena, sizeof(IndexNode));
+        ASSERT_P(node, ERROR_MEH); // The map's arena is full, see MAP_ARENA_BYTES
+        IndexNode** head = index_list(m, to, x >> INDEX_BITS, y >> INDEX_BITS);
+        node->x = x;
+        node->y = y;
+        node->next = *head;
+        *head = node;
+        m->index_count[to - INDEX_FIRST]++;
+    }
+}
+
+/**
+ * Creates an empty w by h map at the lowest free index of the registry, and
+ * returns the index, or -1 if the registry is full or there is not enough
+ * memory. If paged is true the block holds a table of the map's chunks, all
+ * of them out, in place of the tile grid, and the caller gives the map its
+ * file.
+ */
+static int new_map(int w, int h, int paged)
 {
-    active_map = m;
-    if(active_map == 0)
-        return &map;
-    else if(active_map == 1)
-        return &ruins;
+    int i = 0;
+    while (i < MAX_MAPS && maps[i]) i++;
+    if (i == MAX_MAPS || w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF) return -1;
+
+    // One block for the map and its arena, from the AHB bank if it fits
+    int stride = (w + 31) >> 5;
+    int cells = ((w + INDEX_CELL - 1) >> INDEX_BITS) * ((h + INDEX_CELL - 1) >> INDEX_BITS);
+    int cw = (w + CHUNK_SIZE - 1) >> CHUNK_BITS;
+    int ch = (h + CHUNK_SIZE - 1) >> CHUNK_BITS;
+    unsigned tiles_size = paged ? cw * ch * sizeof(unsigned char*) : w * h;
+    unsigned size = (sizeof(Map) + tiles_size + stride * h * 4 + INDEX_TYPES * cells * sizeof(IndexNode*)
+                     + MAP_ARENA_BYTES + 7) & ~7u;
+    Map* m = (Map*) bank_take(size);
+    if (!m) m = (Map*) malloc(size);
+    if (!m) return -1;
+    memset(m, 0, sizeof(Map));
+    m->arena.next = m->arena.high = (char*) (m + 1);
+    m->arena.end = (char*) m + size;
+
+    if (paged)
+    {
+        // No chunk is resident yet
+        m->chunks = (unsigned char**) arena_alloc(&m->arena, tiles_size);
+        memset(m->chunks, 0, tiles_size);
+        m->cw = cw;
+        m->ch = ch;
+    }
     else
-        return NULL;
+    {
+        // Allocate the tile grid, with every tile empty
+        m->tiles = (unsigned char*) arena_alloc(&m->arena, tiles_size);
+        memset(m->tiles, TILE_EMPTY, tiles_size);
+    }
+    // Empty tiles are walkable
+    m->walk = (unsigned*) arena_alloc(&m->arena, stride * h * 4);
+    m->walk_stride = stride;
+    m->w = w;
+    m->h = h;
+    clear_walk(m);
+    // Nothing is indexed yet
+    m->index = (IndexNode**) arena_alloc(&m->arena, INDEX_TYPES * cells * sizeof(IndexNode*));
+    memset(m->index, 0, INDEX_TYPES * cells * sizeof(IndexNode*));
+    clear_index(m);
+    HashAllocator allocator = { arena_hash_alloc, arena_hash_release, m };
+    m->items = createHashTable(map_hash, OVERLAY_BUCKETS, HASH_CHAINED, &allocator);
+    // Start the entry pool small, rather than with a whole slab
+    void* entries = arena_alloc(&m->arena, HASH_POOL_BYTES(MAP_POOL_ENTRIES));
+    if (!m->items || !entries)
+    {
+        // The arena is too small for the table, see MAP_ARENA_BYTES
+        if (!in_bank(m)) free(m);
+        return -1;
+    }
+    hashTableUseBuffer(m->items, entries, HASH_POOL_BYTES(MAP_POOL_ENTRIES));
+    maps[i] = m;
+    return i;
 }
 
-Map* get_map(int m)
+int map_create(int w, int h)
+{
+    return new_map(w, h, false);
+}
+
+/**
+ * Returns a MapItem from map m's arena, reusing a released one if there is one.
+ */
+static MapItem* new_item(Map* m)
+{
+    MapItem* item = m->free_items;
+    if (item)
+        m->free_items = (MapItem*) item->data;
+    else
+        item = (MapItem*) arena_alloc(&m->arena, sizeof(MapItem));
+    ASSERT_P(item, ERROR_MEH); // The map's arena is full, see MAP_ARENA_BYTES
+    return item;
+}
+
+/**
+ * Gives an overlay MapItem of map m back for reuse. NULL is ignored.
+ */
+static void release_item(Map* m, MapItem* item)
+{
+    if (!item) return;
+    item->data = m->free_items;
+    m->free_items = item;
+}
+
+/**
+ * Writes tiles to the file of map m as chunk c. Overlay items are not saved,
+ * so their tiles go out as TILE_EMPTY, and load_chunk puts them back. Returns
+ * false if the write failed.
+ */
+static int write_chunk(Map* m, int c, const unsigned char* tiles)
+{
+    unsigned char out[CHUNK_TILES];
+    for (int i = 0; i < CHUNK_TILES; i++)
+        out[i] = (tiles[i] == TILE_OVERLAY) ? TILE_EMPTY : tiles[i];
+    fseek(m->file, sizeof(MapFileHeader) + c * CHUNK_TILES, SEEK_SET);
+    return fwrite(out, 1, CHUNK_TILES, m->file) == CHUNK_TILES;
+}
+
+/**
+ * Writes a chunk frame back to its file if it changed, and frees it.
+ */
+static void evict_frame(ChunkFrame* f)
+{
+    Map* m = f->map;
+    if (f->dirty)
+    {
+        write_chunk(m, f->chunk, f->tiles);
+        m->page_outs++;
+    }
+    m->chunks[f->chunk] = NULL;
+    f->map = NULL;
+}
+
+/**
+ * The chunk load_chunk is marking the overlay tiles of.
+ */
+typedef struct {
+    unsigned char* tiles;
+    int x0, y0;  // Its top left tile
+} ChunkMark;
+
+/**
+ * HashTableVisitor for load_chunk: marks the tile of an overlay item as
+ * TILE_OVERLAY if it is in the chunk.
+ */
+static int mark_overlay(unsigned key, void* value, void* context)
+{
+    ChunkMark* mark = (ChunkMark*) context;
+    int x = (int) (key >> 16) - mark->x0;
+    int y = (int) (key & 0xFFFF) - mark->y0;
+    if (x >= 0 && x < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE)
+        mark->tiles[y * CHUNK_SIZE + x] = TILE_OVERLAY;
+    return 0;
+}
+
+/**
+ * Pages chunk c of map m in from its file, and returns its tiles.
+ */
+static unsigned char* load_chunk(Map* m, int c)
+{
+    // Take a free frame, or else the least recently used one
+    ChunkFrame* f = &frames[0];
+    for (int i = 0; i < RESIDENT_CHUNKS; i++)
+    {
+        if (!frames[i].map)
+        {
+            f = &frames[i];
+            break;
+        }
+        if (frames[i].stamp < f->stamp) f = &frames[i];
+    }
+    if (f->map) evict_frame(f);
+
+    fseek(m->file, sizeof(MapFileHeader) + c * CHUNK_TILES, SEEK_SET);
+    if (fread(f->tiles, 1, CHUNK_TILES, m->file) != CHUNK_TILES)
+        memset(f->tiles, TILE_EMPTY, CHUNK_TILES);
+
+    // The file has the overlay items' tiles as empty; mark them again. There
+    // are far fewer items than tiles, so walk the items
+    ChunkMark mark = { f->tiles, (c % m->cw) * CHUNK_SIZE, (c / m->cw) * CHUNK_SIZE };
+    hashTableForEach(m->items, mark_overlay, &mark, HASH_ANY_ORDER);
+
+    f->map = m;
+    f->chunk = c;
+    f->dirty = false;
+    m->chunks[c] = f->tiles;
+    m->page_ins++;
+    return f->tiles;
+}
+
+/**
+ * Returns a pointer to the tile ID of (x,y) in map m, paging its chunk in if
+ * needed. (x,y) must be on the map. If write is true, the chunk is marked as
+ * changed. The pointer is only good until the next call, which may page the
+ * chunk back out.
+ */
+static unsigned char* tile_ref(Map* m, int x, int y, int write)
+{
+    if (m->tiles) return &m->tiles[y * m->w + x];
+
+    int c = (y >> CHUNK_BITS) * m->cw + (x >> CHUNK_BITS);
+    unsigned char* chunk = m->chunks[c];
+    if (!chunk) chunk = load_chunk(m, c);
+    ChunkFrame* f = (ChunkFrame*) chunk;
+    f->stamp = ++chunk_clock;
+    if (write) f->dirty = true;
+    return &chunk[(y & (CHUNK_SIZE - 1)) * CHUNK_SIZE + (x & (CHUNK_SIZE - 1))];
+}
+
+int map_create_paged(int w, int h, const char* path)
+{
+    // The file is started over. Whatever an earlier run left in it is game
+    // state (an opened door, where the NPC was), not the map that the builders
+    // make, so it is never read back.
+    FILE* file = fopen(path, "w+b");
+    if (!file) return -1;
+    int i = new_map(w, h, true);
+    if (i < 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    Map* m = maps[i];
+    m->file = file;
+
+    // Every chunk starts out empty. The builders then write the tiles through
+    // the chunk frames, so the map is never whole in RAM.
+    MapFileHeader header;
+    header.magic = MAP_FILE_MAGIC;
+    header.w = w;
+    header.h = h;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    unsigned char empty[CHUNK_TILES];
+    memset(empty, TILE_EMPTY, CHUNK_TILES);
+    for (int c = 0; ok && c < m->cw * m->ch; c++)
+        ok = write_chunk(m, c, empty);
+    if (!ok || fflush(file) != 0)
+    {
+        map_destroy(i);
+        return -1;
+    }
+    return i;
+}
+
+void map_sync()
+{
+    for (int i = 0; i < RESIDENT_CHUNKS; i++)
+    {
+        ChunkFrame* f = &frames[i];
+        if (f->map && f->dirty)
+        {
+            write_chunk(f->map, f->chunk, f->tiles);
+            fflush(f->map->file);
+            f->map->page_outs++;
+            f->dirty = false;
+        }
+    }
+}
+
+void map_destroy(int m)
+{
+    if (m < 0 || m >= MAX_MAPS || !maps[m]) return;
+    Map* mp = maps[m];
+
+    if (mp->file)
+    {
+        // Save its resident chunks and give their frames up
+        for (int i = 0; i < RESIDENT_CHUNKS; i++)
+            if (frames[i].map == mp) evict_frame(&frames[i]);
+        fclose(mp->file);
+    }
+    // Everything else is in the block, so giving it up frees the whole map
+    maps[m] = NULL;
+    if (!in_bank(mp)) free(mp);
+
+    if (active == mp)
+    {
+        active = NULL;
+        active_map = -1;
+    }
+}
+
+/**
+ * Returns the item at (x,y) of map m. (x,y) must be on the map.
+ */
+static MapItem* tile_item(Map* m, int x, int y)
+{
+    unsigned char tile = *tile_ref(m, x, y, false);
+    if (tile == TILE_EMPTY) return NULL;
+    if (tile == TILE_OVERLAY) return (MapItem*) getItem(m->items, XY_KEY(x, y));
+    return (MapItem*) &prototypes[tile];
+}
+
+/**
+ * Sets (x,y) of map m to a stateless tile (or TILE_EMPTY), freeing any overlay
+ * item that was there. (x,y) must be on the map.
+ */
+static void put_tile(Map* m, int x, int y, unsigned char tile)
+{
+    unsigned char* ref = tile_ref(m, x, y, true);
+    int old = NO_TYPE;
+    if (*ref == TILE_OVERLAY)
+    {
+        // As in map_remove, a tile marked as an overlay need not have an item
+        MapItem* item = (MapItem*) removeItem(m->items, XY_KEY(x, y));
+        if (item) old = item->type;
+        release_item(m, item);
+    }
+    else if (*ref != TILE_EMPTY)
+        old = prototypes[*ref].type;
+    *ref = tile;
+    set_walk(m, x, y, prototypes[tile].walkable);
+    index_move(m, x, y, old, (tile == TILE_EMPTY) ? NO_TYPE : prototypes[tile].type);
+}
+
+/**
+ * Sets (x,y) of the active map to a stateless tile (or TILE_EMPTY), freeing
+ * any overlay item that was there. Tiles off the map are ignored.
+ */
+static void set_tile(int x, int y, unsigned char tile)
+{
+    Map* m = get_active_map();
+    if (x < 0 || x >= m->w || y < 0 || y >= m->h) return;
+    put_tile(m, x, y, tile);
+}
+
+/**
+ * Sets the walkability of len tiles of row y of map m, starting at x, a word
+ * at a time. The tiles must be on the map.
+ */
+static void set_walk_run(Map* m, int x, int y, int len, int walkable)
+{
+    unsigned* row = m->walk + y * m->walk_stride;
+    while (len > 0)
+    {
+        int n = 32 - (x & 31);
+        if (n > len) n = len;
+        unsigned mask = (n == 32) ? 0xFFFFFFFF : ((1u << n) - 1) << (x & 31);
+        unsigned old = row[x >> 5];
+        row[x >> 5] = walkable ? (old | mask) : (old & ~mask);
+        for (unsigned flipped = row[x >> 5] ^ old; flipped; flipped &= flipped - 1)
+            log_walk(m, (x & ~31) + __builtin_ctz(flipped), y);
+        x += n;
+        len -= n;
+    }
+}
+
+/**
+ * Sets a line of len tiles of map m, from (x,y) across if horizontal or else
+ * down, to a stateless tile whose type is not indexed (like TILE_WALL). The
+ * line must be on the map.
+ *
+ * This is what makes long walls cheap: the line is written a run at a time,
+ * with one tile_ref per run (the whole line in the dense grid, or the part in
+ * one chunk when paged), and a horizontal line's walkability bits a word at a
+ * time. Only a tile that holds an overlay item or an indexed type needs the
+ * full put_tile.
+ */
+static void fill_line(Map* m, int x, int y, int horizontal, int len, unsigned char tile)
 {
-    if(m == 0)
-        return &map;
-    else if(m == 1)
-        return &ruins;
+    for (int i = 0; i < len; )
+    {
+        int tx = horizontal ? x + i : x;
+        int ty = horizontal ? y : y + i;
+        int n = len - i;
+        int step = horizontal ? 1 : m->w;
+        if (m->chunks)
+        {
+            int room = CHUNK_SIZE - ((horizontal ? tx : ty) & (CHUNK_SIZE - 1));
+            if (room < n) n = room;
+            step = horizontal ? 1 : CHUNK_SIZE;
+        }
+        unsigned char* ref = tile_ref(m, tx, ty, true);
+        for (int k = 0; k < n; k++, ref += step)
+        {
+            if (*ref == TILE_OVERLAY || INDEXED(prototypes[*ref].type))
+                put_tile(m, horizontal ? tx + k : tx, horizontal ? ty : ty + k, tile);
+            else
+                *ref = tile;
+        }
+        i += n;
+    }
+
+    int walkable = prototypes[tile].walkable;
+    if (horizontal)
+        set_walk_run(m, x, y, len, walkable);
     else
-        return &map; //default to map
+        for (int i = 0; i < len; i++)
+            set_walk(m, x, y + i, walkable);
+}
+
+/**
+ * Puts item in the overlay at (x,y) of the active map, replacing (and freeing)
+ * whatever was there. Returns true, or false if (x,y) is off the map or the
+ * overlay table has no memory for it, in which case item is freed and the
+ * tile is left as it was.
+ */
+static int add_overlay(int x, int y, MapItem* item)
+{
+    Map* m = get_active_map();
+    if (x < 0 || x >= m->w || y < 0 || y >= m->h)
+    {
+        release_item(m, item);
+        return false;
+    }
+    unsigned char* ref = tile_ref(m, x, y, true);
+    int old = (*ref == TILE_EMPTY || *ref == TILE_OVERLAY) ? NO_TYPE : prototypes[*ref].type;
+    // If something is already there, release it
+    MapItem* prev = (MapItem*) insertItem(m->items, XY_KEY(x, y), item);
+    if (prev == HASH_NO_MEMORY)
+    {
+        // The map's arena is full, see MAP_ARENA_BYTES
+        release_item(m, item);
+        return false;
+    }
+    if (prev) old = prev->type;
+    release_item(m, prev);
+    *ref = TILE_OVERLAY;
+    set_walk(m, x, y, item->walkable);
+    index_move(m, x, y, old, item->type);
+    return true;
+}
+
+Map* get_active_map()
+{
+    return active;
+}
+
+int get_active_map_index()
+{
+    return active_map;
+}
+
+Map* set_active_map(int m)
+{
+    Map* mp = get_map(m);
+    if (mp)
+    {
+        active = mp;
+        active_map = m;
+    }
+    return mp;
+}
+
+Map* get_map(int m)
+{
+    if (m < 0 || m >= MAX_MAPS) return NULL;
+    return maps[m];
 }
 
 void print_map()
 {
     // As you add more types, you'll need to add more items to this array.
     char lookup[] = {'W', 'P', 'N', 'K', 'D', 'S', 'I'};
-    for(int y = 0; y < map_height(); y++)
+    Map* m = get_active_map();
+    for(int y = 0; y < m->h; y++)
     {
-        for (int x = 0; x < map_width(); x++)
+        for (int x = 0; x < m->w; x++)
         {
-            MapItem* item = get_here(x,y);
+            // Only overlay tiles need a hash lookup
+            MapItem* item = tile_item(m, x, y);
             if (item) pc.printf("%c", lookup[item->type]);
             else pc.printf(" ");
         }
@@ -107,170 +936,484 @@ void print_map()
     }
 }
 
+void print_map_stats()
+{
+#if HASH_TABLE_STATS
+    HashTable* items = get_active_map()->items;
+    HashTableStats stats;
+    hashTableGetStats(items, &stats);
+
+    pc.printf("Map %d: %u items in %u buckets, load %u%%\r\n", active_map,
+              stats.num_items, stats.num_buckets, stats.load_percent);
+    pc.printf("Chain lengths:");
+    for (int i = 0; i < HASH_STATS_BINS; i++)
+        pc.printf(" %d%s:%u", i, (i == HASH_STATS_BINS - 1) ? "+" : "", stats.histogram[i]);
+    pc.printf("\r\n");
+    pc.printf("Lookups: %u (%u hit, %u miss), probes avg %u.%02u max %u\r\n",
+              stats.gets, stats.hits, stats.misses,
+              stats.gets ? stats.probes / stats.gets : 0,
+              stats.gets ? stats.probes * 100 / stats.gets % 100 : 0,
+              stats.max_probes);
+    pc.printf("Entry pool: %u used of %u, high water %u\r\n", hashTablePoolUsed(items),
+              hashTablePoolCapacity(items), hashTablePoolHighWater(items));
+    Map* m = get_active_map();
+    if (m->file)
+        pc.printf("Tiles: %dx%d in %dx%d chunks, %d resident slots, %u page ins, %u page outs\r\n",
+                  m->w, m->h, m->cw, m->ch, RESIDENT_CHUNKS, m->page_ins, m->page_outs);
+    else
+        pc.printf("Tile grid: %dx%d, %d bytes\r\n", m->w, m->h, map_area());
+    hashTableResetStats(items);
+#else
+    pc.printf("Hash table stats are compiled out (HASH_TABLE_STATS)\r\n");
+#endif
+}
+
+unsigned map_memory(Map* m)
+{
+    return m->arena.end - (char*) m;
+}
+
+void print_memory_report()
+{
+    // The heap never gives memory back to the system, so arena is its peak
+    struct mallinfo mi = mallinfo();
+    pc.printf("Heap: peak %u bytes, %u in use, %u free in %u fragments\r\n",
+              (unsigned) mi.arena, (unsigned) mi.uordblks, (unsigned) mi.fordblks, (unsigned) mi.ordblks);
+    for (int i = 0; i < MAX_MAPS; i++)
+    {
+        Map* m = maps[i];
+        if (!m) continue;
+        char* start = (char*) (m + 1);
+        pc.printf("Map %d: %dx%d in %s, arena %u of %u bytes used, peak %u\r\n", i, m->w, m->h,
+                  in_bank(m) ? "AHB SRAM" : "heap", (unsigned) (m->arena.next - start),
+                  (unsigned) (m->arena.end - start), (unsigned) (m->arena.high - start));
+    }
+}
+
+void print_hash_report()
+{
+    // Hash every tile of the active map into HASH_REPORT_BUCKETS buckets
+    #define HASH_REPORT_BUCKETS 256
+    static unsigned short counts[HASH_REPORT_BUCKETS];
+    Map* m = get_active_map();
+    unsigned n = m->w * m->h;
+
+    pc.printf("Hash distribution of %u keys over %d buckets (100%% = random):\r\n", n, HASH_REPORT_BUCKETS);
+    for (int c = 0; c < NUM_CANDIDATE_HASHES; c++)
+    {
+        memset(counts, 0, sizeof(counts));
+        Timer t; t.start();
+        for (int y = 0; y < m->h; y++)
+            for (int x = 0; x < m->w; x++)
+                counts[candidate_hashes[c].hash(XY_KEY(x, y)) & (HASH_REPORT_BUCKETS - 1)]++;
+        t.stop();
+
+        // Compare the sum of squared bucket sizes with what random hashing
+        // would give on average: n + n(n-1)/buckets
+        unsigned empty = 0, max = 0;
+        float squares = 0;
+        for (int i = 0; i < HASH_REPORT_BUCKETS; i++)
+        {
+            if (counts[i] == 0) empty++;
+            if (counts[i] > max) max = counts[i];
+            squares += (float) counts[i] * counts[i];
+        }
+        float expected = n + (float) n * (n - 1) / HASH_REPORT_BUCKETS;
+        pc.printf("  %-10s %3u%%, %3u empty, longest %3u, %d us\r\n", candidate_hashes[c].name,
+                  (unsigned) (100 * squares / expected + 0.5f), empty, max, t.read_us());
+    }
+}
+
 int map_width()
 {
-    return get_active_map()->w;
+    return active->w;
 }
 
 int map_height()
 {
-    return get_active_map()->h;
+    return active->h;
 }
 
 int map_area()
 {
-    return get_active_map()->w * get_active_map()->h;
+    return active->w * active->h;
 }
 
 MapItem* get_north(int x, int y)
 {
-    // Check if there is no northern tile
-    if(y <= 0)
-        return NULL;
-    return (MapItem*) getItem(get_active_map()->items, XY_KEY(x, y - 1));
+    return get_here(x, y - 1);
 }
 
 MapItem* get_south(int x, int y)
 {
-    // Check if there is no southern tile
-    if(y >= get_active_map()->h - 1)
-        return NULL;
-    return (MapItem*) getItem(get_active_map()->items, XY_KEY(x, y + 1));
+    return get_here(x, y + 1);
 }
 
 MapItem* get_east(int x, int y)
 {
-    // Check if there is no eastern tile
-    if(x >= get_active_map()->w - 1)
-        return NULL;
-    return (MapItem*) getItem(get_active_map()->items, XY_KEY(x + 1, y));
+    return get_here(x + 1, y);
 }
 
 MapItem* get_west(int x, int y)
 {
-    // Check if there is no western tile
-    if(x <= 0)
-        return NULL;
-    return (MapItem*) getItem(get_active_map()->items, XY_KEY(x - 1, y));
+    return get_here(x - 1, y);
 }
 
 MapItem* get_here(int x, int y)
+{
+    return map_get(get_active_map(), x, y);
+}
+
+MapItem* map_get(Map* m, int x, int y)
 {
     // Check if tile is on map
-    if(x > -1 && x < get_active_map()->w && y > -1 && y < get_active_map()->h)
-        return (MapItem*) getItem(get_active_map()->items, XY_KEY(x, y));
+    if(x > -1 && x < m->w && y > -1 && y < m->h)
+        return tile_item(m, x, y);
     else
         return NULL;
 }
 
+void map_get_rect(int x0, int y0, int w, int h, MapItem** out)
+{
+    Map* m = get_active_map();
+
+    for (int j = 0; j < h; j++)
+    {
+        MapItem** row = out + j * w;
+        int y = y0 + j;
+        for (int i = 0; i < w; i++)
+        {
+            int x = x0 + i;
+            row[i] = (x >= 0 && x < m->w && y >= 0 && y < m->h) ? tile_item(m, x, y) : NULL;
+        }
+    }
+}
+
+int map_walkable(int x, int y)
+{
+    Map* m = active;
+    if (x < 0 || x >= m->w || y < 0 || y >= m->h) return true;
+    return (m->walk[y * m->walk_stride + (x >> 5)] >> (x & 31)) & 1;
+}
+
+void map_set_walkable(int x, int y, int walkable)
+{
+    MapItem* item = map_edit(x, y);
+    if (!item) return;
+    item->walkable = walkable;
+    set_walk(active, x, y, walkable);
+}
+
+const unsigned* map_walk_row(Map* m, int y)
+{
+    return m->walk + y * m->walk_stride;
+}
+
+int map_walk_stride(Map* m)
+{
+    return m->walk_stride;
+}
+
+unsigned map_walk_generation(Map* m)
+{
+    return m->walk_gen;
+}
+
+int map_walk_changes(Map* m, unsigned gen, MapCell* out, int max)
+{
+    if (gen < m->walk_floor) return -1;
+    int n = 0;
+    unsigned first = (m->walk_logged > WALK_LOG) ? m->walk_logged - WALK_LOG : 0;
+    for (unsigned i = first; i < m->walk_logged; i++)
+    {
+        WalkChange* c = &m->walk_log[i % WALK_LOG];
+        if (c->gen <= gen) continue;
+        if (n == max) return -1;
+        out[n].item = NULL;
+        out[n].x = c->x;
+        out[n].y = c->y;
+        n++;
+    }
+    return n;
+}
+
+void map_neighbours(int x, int y, MapNeighbourhood* nb)
+{
+    MapItem* items[9];
+    map_get_rect(x - 1, y - 1, 3, 3, items);
+    for (int i = 0; i < 9; i++)
+    {
+        nb->cells[i].item = items[i];
+        nb->cells[i].x = x - 1 + i % 3;
+        nb->cells[i].y = y - 1 + i / 3;
+    }
+}
+
+MapCell* map_find_near(MapNeighbourhood* nb, int type, int on)
+{
+    static const int order[] = { NB_NORTH, NB_WEST, NB_EAST, NB_SOUTH, NB_HERE };
+    int n = on ? 5 : 4;
+    for (int i = 0; i < n; i++)
+    {
+        MapCell* cell = &nb->cells[order[i]];
+        if (cell->item && cell->item->type == type) return cell;
+    }
+    return NULL;
+}
+
+int map_find_nearest(int type, int x, int y, MapCell* out)
+{
+    Map* m = active;
+    if (!INDEXED(type) || !m->index_count[type - INDEX_FIRST]) return false;
+
+    // Search the rings of cells around the cell of (x,y), nearest first
+    int cx = x >> INDEX_BITS;
+    int cy = y >> INDEX_BITS;
+    if (cx < 0) cx = 0;
+    if (cx >= m->index_cw) cx = m->index_cw - 1;
+    if (cy < 0) cy = 0;
+    if (cy >= m->index_ch) cy = m->index_ch - 1;
+    int rings = cx;
+    if (m->index_cw - 1 - cx > rings) rings = m->index_cw - 1 - cx;
+    if (cy > rings) rings = cy;
+    if (m->index_ch - 1 - cy > rings) rings = m->index_ch - 1 - cy;
+
+    unsigned best = 0xFFFFFFFF;
+    for (int r = 0; r <= rings; r++)
+    {
+        // Every tile in ring r is at least (r - 1) * INDEX_CELL + 1 tiles away
+        // in x or in y, so stop once that is further than the best so far
+        if (r > 0)
+        {
+            unsigned gap = (r - 1) * INDEX_CELL + 1;
+            if (gap * gap > best) break;
+        }
+        for (int j = cy - r; j <= cy + r; j++)
+        {
+            if (j < 0 || j >= m->index_ch) continue;
+            // The top and bottom rows of the ring are whole, the others are just the ends
+            int step = (j == cy - r || j == cy + r) ? 1 : 2 * r;
+            for (int i = cx - r; i <= cx + r; i += step)
+            {
+                if (i < 0 || i >= m->index_cw) continue;
+                for (IndexNode* node = *index_list(m, type, i, j); node; node = node->next)
+                {
+                    int dx = node->x - x;
+                    int dy = node->y - y;
+                    unsigned d = (unsigned) dx * dx + (unsigned) dy * dy;
+                    // Ties go to the first in row-major order, wherever the cells are
+                    if (d < best || (d == best && (node->y < out->y || (node->y == out->y && node->x < out->x))))
+                    {
+                        best = d;
+                        out->x = node->x;
+                        out->y = node->y;
+                    }
+                }
+            }
+        }
+    }
+    out->item = tile_item(m, out->x, out->y);
+    return true;
+}
+
+int map_find_in_rect(int type, int x0, int y0, int w, int h, MapCell* out, int max)
+{
+    Map* m = active;
+    if (!INDEXED(type) || !m->index_count[type - INDEX_FIRST]) return 0;
+
+    // Clip the rectangle to the map
+    int x1 = (x0 + w < m->w) ? x0 + w - 1 : m->w - 1;
+    int y1 = (y0 + h < m->h) ? y0 + h - 1 : m->h - 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x0 > x1 || y0 > y1) return 0;
+
+    int n = 0;
+    for (int j = y0 >> INDEX_BITS; j <= y1 >> INDEX_BITS; j++)
+        for (int i = x0 >> INDEX_BITS; i <= x1 >> INDEX_BITS; i++)
+            for (IndexNode* node = *index_list(m, type, i, j); node; node = node->next)
+            {
+                if (node->x < x0 || node->x > x1 || node->y < y0 || node->y > y1) continue;
+                if (n < max)
+                {
+                    out[n].item = tile_item(m, node->x, node->y);
+                    out[n].x = node->x;
+                    out[n].y = node->y;
+                }
+                n++;
+            }
+    return n;
+}
 
 void map_erase(int x, int y)
 {
-    deleteItem(get_active_map()->items, XY_KEY(x, y));
+    set_tile(x, y, TILE_EMPTY);
 }
 
 void* map_remove(int x, int y)
 {
-    return removeItem(get_active_map()->items, XY_KEY(x,y));
+    Map* m = get_active_map();
+    if (x < 0 || x >= m->w || y < 0 || y >= m->h) return NULL;
+
+    // A stateless tile just becomes empty; its prototype is returned
+    set_walk(m, x, y, true);
+    unsigned char* tile = tile_ref(m, x, y, true);
+    MapItem* item;
+    if (*tile == TILE_OVERLAY)
+        item = (MapItem*) removeItem(m->items, XY_KEY(x,y));
+    else
+        item = (*tile == TILE_EMPTY) ? NULL : (MapItem*) &prototypes[*tile];
+    *tile = TILE_EMPTY;
+    if (item) index_move(m, x, y, item->type, NO_TYPE);
+    return item;
+}
+
+MapItem* map_edit(int x, int y)
+{
+    Map* m = get_active_map();
+    if (x < 0 || x >= m->w || y < 0 || y >= m->h) return NULL;
+
+    unsigned char tile = *tile_ref(m, x, y, false);
+    if (tile == TILE_EMPTY) return NULL;
+    if (tile == TILE_OVERLAY) return (MapItem*) getItem(m->items, XY_KEY(x, y));
+
+    // Copy on write: this tile gets its own copy of the prototype
+    MapItem* copy = new_item(m);
+    *copy = prototypes[tile];
+    return add_overlay(x, y, copy) ? copy : NULL;
 }
 
 void add_wall(int x, int y, int dir, int len)
 {
-    for(int i = 0; i < len; i++)
-    {
-        MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
-        w1->type = WALL;
-        w1->draw = draw_wall;
-        w1->walkable = false;
-        w1->data = NULL;
-        unsigned key = (dir == HORIZONTAL) ? XY_KEY(x+i, y) : XY_KEY(x, y+i);
-        void* val = insertItem(get_active_map()->items, key, w1);
-        if (val) free(val); // If something is already there, free it
-    }
+    Map* m = get_active_map();
+    int horizontal = (dir == HORIZONTAL);
+
+    // Clip the line to the map
+    int across = horizontal ? y : x;
+    int start = horizontal ? x : y;
+    int end = start + len;
+    int size = horizontal ? m->w : m->h;
+    if (across < 0 || across >= (horizontal ? m->h : m->w)) return;
+    if (start < 0) start = 0;
+    if (end > size) end = size;
+    if (start >= end) return;
+
+    if (horizontal) fill_line(m, start, y, true, end - start, TILE_WALL);
+    else fill_line(m, x, start, false, end - start, TILE_WALL);
+}
+
+void add_wall_rect(int x, int y, int w, int h)
+{
+    add_wall(x,         y,         HORIZONTAL, w);
+    add_wall(x,         y + h - 1, HORIZONTAL, w);
+    add_wall(x,         y + 1,     VERTICAL,   h - 2);
+    add_wall(x + w - 1, y + 1,     VERTICAL,   h - 2);
 }
 
 void add_plant(int x, int y)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
-    w1->type = PLANT;
-    w1->draw = draw_plant;
-    w1->walkable = true;
-    w1->data = NULL;
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    set_tile(x, y, TILE_PLANT);
 }
 
 void add_NPC(int x, int y, int* state)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
+    MapItem* w1 = new_item(get_active_map());
     w1->type = NPC;
     w1->draw = draw_NPC;
     w1->walkable = false;
     w1->data = state;
     pc.printf("NPC created with data %u\r\n", *((int*)w1->data));
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    add_overlay(x, y, w1);
 }
 
 void add_key(int x, int y)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
-    w1->type = KEY;
-    w1->draw = draw_key;
-    w1->walkable = true;
-    w1->data = NULL;
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    set_tile(x, y, TILE_KEY);
 }
 
 void add_door(int x, int y, int open)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
-    w1->type = DOOR;
-    w1->draw = (open) ? draw_door_open : draw_door_closed;
-    w1->walkable = (open) ? true : false; // if the door is open, you can walk through it
-    w1->data = NULL;
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    // if the door is open, you can walk through it
+    set_tile(x, y, (open) ? TILE_DOOR_OPEN : TILE_DOOR_CLOSED);
 }
 
 void add_stairs(int x, int y, int* map)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
+    MapItem* w1 = new_item(get_active_map());
     w1->type = STAIRS;
     w1->draw = draw_stairs;
     w1->walkable = true;
     w1->data = map; //data points to the map the stairs lead to
     pc.printf("NPC created with data %u\r\n", *((int*)w1->data));
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    add_overlay(x, y, w1);
 }
 
 void add_win_item(int x, int y)
 {
-    MapItem* w1 = (MapItem*) malloc(sizeof(MapItem));
-    w1->type = WIN_ITEM;
-    w1->draw = draw_win_item;
-    w1->walkable = true;
-    w1->data = NULL;
-    void* val = insertItem(get_active_map()->items, XY_KEY(x, y), w1);
-    if (val) free(val); // If something is already there, free it
+    set_tile(x, y, TILE_WIN_ITEM);
 }
 
 void add_maze(int x, int y, const char* maze)
 {
-    for(int i = 0; i < 11*11; i++)
+    for(int i = 0; i < MAZE_CELLS; i++)
     {
         if(maze[i] == 'w')
-            add_wall(x + i % 11, y + i / 11, HORIZONTAL, 1);
+            add_wall(x + i % MAZE_W, y + i / MAZE_W, HORIZONTAL, 1);
     }
 }
 
 void remove_maze(int x, int y, const char* maze)
 {
-    for(int i = 0; i < 11*11; i++)
+    for(int i = 0; i < MAZE_CELLS; i++)
     {
         if(maze[i] == 'w')
-            map_erase(x + i % 11, y + i / 11);
+            map_erase(x + i % MAZE_W, y + i / MAZE_W);
+    }
+}
+
+void maze_diff(const char* from, const char* to, MazeDiff* diff)
+{
+    diff->count = 0;
+    for (int i = 0; i < MAZE_CELLS; i++)
+    {
+        if ((from[i] == 'w') != (to[i] == 'w'))
+            diff->cells[diff->count++] = i;
+    }
+}
+
+int maze_apply(int x, int y, const char* to, const MazeDiff* diff)
+{
+    for (int i = 0; i < diff->count; i++)
+    {
+        int cell = diff->cells[i];
+        int cx = x + cell % MAZE_W;
+        int cy = y + cell / MAZE_W;
+        if (to[cell] == 'w')
+            add_wall(cx, cy, HORIZONTAL, 1);
+        else
+            map_erase(cx, cy);
     }
+    return diff->count;
+}
+
+void maze_chain_init(MazeChain* chain, int x, int y, const char** states, int n, MazeDiff* diffs)
+{
+    chain->x = x;
+    chain->y = y;
+    chain->states = states;
+    chain->diffs = diffs;
+    chain->n = n;
+    chain->current = 0;
+    for (int i = 0; i < n; i++)
+        maze_diff(states[i], states[(i + 1) % n], &diffs[i]);
+    add_maze(x, y, states[0]);
+}
+
+int maze_chain_step(MazeChain* chain)
+{
+    int next = (chain->current + 1) % chain->n;
+    int count = maze_apply(chain->x, chain->y, chain->states[next],
+                           &chain->diffs[chain->current]);
+    chain->current = next;
+    return count;
 }
@@ -62,34 +62,110 @@ typedef struct {
 #define WIN_ITEM 6
 
 /**
- * Initializes the internal structures for all maps. This does not populate
- * the map with items, but allocates space for them, initializes the hash tables, 
- * and sets the width and height.
+ * Initializes the map registry, with no maps in it. Maps are then added with
+ * map_create.
  */
 void maps_init();
 
 /**
- * Returns a pointer to the active map.
+ * Creates an empty w by h map and returns its index, or -1 if the registry is
+ * full or there is not enough memory. This allocates the tile grid and
+ * initializes the hash table, but does not populate the map with items or
+ * make it active.
+ */
+int map_create(int w, int h);
+
+/**
+ * Destroys map m and frees its index for reuse. Its tiles, its hash table and
+ * all of its items share one block of memory, which is freed in one step
+ * however many items the map has. A paged map has its changed chunks written
+ * back and its file closed. If m was the active map, there is no active map
+ * afterwards.
+ */
+void map_destroy(int m);
+
+/**
+ * Returns a pointer to the active map, or NULL if there is none.
  */
 Map* get_active_map();
 
+/**
+ * Returns the index of the active map, or -1 if there is none.
+ */
+int get_active_map_index();
+
 /**
  * Sets the active map to map m, where m is the index of the map to activate.
- * Returns a pointer to the new active map.
+ * Returns a pointer to the new active map, or NULL (leaving the active map
+ * unchanged) if there is no map m.
  */
 Map* set_active_map(int m);
 
 /**
- * Returns the map m, regardless of whether it is the active map. This function
- * does not change the active map.
+ * Returns the map m, regardless of whether it is the active map, or NULL if
+ * there is no map m. This function does not change the active map.
  */
 Map* get_map(int m);
 
+/**
+ * Creates an empty w by h map like map_create, but with its tiles kept in the
+ * map file at path instead of a grid in RAM. The file is split into 16x16
+ * chunks, and only the few chunks in use (those near the player) are in RAM
+ * at a time, in frames that every paged map shares. The map's own memory
+ * holds a table of its chunks in place of the grid; what still grows with its
+ * area is the walkability bitset (one bit per tile) and the type index.
+ *
+ * The file is created, or started over with every tile empty: it is scratch
+ * space for the map, and nothing an earlier run left in it is read back. The
+ * overlay items (NPCs, stairs, tiles changed with map_edit) stay in RAM, and
+ * their tiles are saved as empty.
+ *
+ * Returns the index of the map, or -1 if the registry is full, there is not
+ * enough memory, or the file could not be written.
+ */
+int map_create_paged(int w, int h, const char* path);
+
+/**
+ * Writes any changed chunks of the paged maps back to their files.
+ */
+void map_sync();
+
 /**
  * Print the active map to the serial console.
  */
 void print_map();
 
+/**
+ * Print the hash table statistics of the active map to the serial console:
+ * the chain length histogram, the probes per lookup, hits and misses, the
+ * load factor and the entry pool counters. The lookup counters are reset
+ * afterwards, so each dump covers the lookups since the last one.
+ * Prints a short notice instead when HASH_TABLE_STATS is compiled out.
+ */
+void print_map_stats();
+
+/**
+ * Returns the bytes of RAM that map m takes up: its one block of memory, with
+ * its arena. The chunk frames of a paged map are shared, so they are not
+ * counted.
+ */
+unsigned map_memory(Map* m);
+
+/**
+ * Print the heap usage (peak, in use, and free space with the number of
+ * fragments it is split into) and, for each map, where its block is and how
+ * much of its arena is used, to the serial console.
+ */
+void print_memory_report();
+
+/**
+ * Benchmark the candidate hash functions for map keys: hash every tile of the
+ * active map into a fixed number of buckets and print, for each one, how the
+ * spread compares with random hashing, the empty buckets, the longest bucket
+ * and the time taken.
+ */
+void print_hash_report();
+
 // Access
 /**
  * Returns the width of the active map.
@@ -128,9 +204,145 @@ MapItem* get_west(int x, int y);
 
 /**
  * Returns the MapItem at the given location.
+ *
+ * Stateless tiles (walls, plants, keys, doors, thrones) are stored as one byte
+ * each in a dense grid and all point at one const prototype MapItem per kind,
+ * so the returned item must not be changed or freed. Use map_edit to change a
+ * tile.
  */
 MapItem* get_here(int x, int y);
 
+/**
+ * Returns the MapItem at (x,y) of map m, which need not be the active map, or
+ * NULL if there is nothing there or (x,y) is off the map. The same rules as
+ * for get_here apply to the returned item.
+ */
+MapItem* map_get(Map* m, int x, int y);
+
+/**
+ * Returns the MapItem at the given location in a form that is safe to change.
+ * If the tile points at a shared prototype, it is first given its own copy
+ * (copy on write). Returns NULL if there is nothing at (x,y), or if the map
+ * has no memory left for the copy. Use
+ * map_set_walkable to change whether it is walkable.
+ */
+MapItem* map_edit(int x, int y);
+
+/**
+ * Fill out with the MapItems of the w by h rectangle whose top left tile is
+ * (x0,y0), in row-major order: the item at (x0+i, y0+j) goes to out[j*w + i].
+ * Tiles that are empty or off the map are NULL. This does the work of w*h
+ * get_here calls in one pass, resolving the active map only once.
+ */
+void map_get_rect(int x0, int y0, int w, int h, MapItem** out);
+
+/**
+ * Returns true if (x,y) of the active map can be walked onto: it is empty, or
+ * its MapItem is walkable. Tiles off the map count as walkable, just as
+ * get_here returns NULL for them. This reads the map's walkability bitset, so
+ * it costs one word load and a mask, with no MapItem lookup.
+ */
+int map_walkable(int x, int y);
+
+/**
+ * Sets whether the MapItem at (x,y) of the active map is walkable, for state
+ * changes like a door opening. The item gets its own copy first if it shares
+ * a prototype (see map_edit), and the walkability bitset is kept in sync.
+ * Does nothing if the tile is empty. Changing walkable on an item directly
+ * would leave the bitset out of date.
+ */
+void map_set_walkable(int x, int y, int walkable);
+
+/**
+ * Returns row y of the walkability bitset of map m, as map_walk_stride(m)
+ * 32-bit words. Bit (x % 32) of word x / 32 is set if tile x is walkable, and
+ * the bits past the width of the map are clear, so whole words can be used
+ * for 32 tiles at a time. y must be on the map.
+ */
+const unsigned* map_walk_row(Map* m, int y);
+
+/**
+ * Returns the number of 32-bit words in each row of map m's walkability bitset.
+ */
+int map_walk_stride(Map* m);
+
+/**
+ * Returns a stamp that changes whenever map m's walkability bitset does. Two
+ * calls that return the same stamp for the same map saw the same bitset.
+ */
+unsigned map_walk_generation(Map* m);
+
+/**
+ * One tile of a neighbourhood, of a type query or of map_walk_changes: the
+ * MapItem there (NULL if the tile is empty or off the map, and always for a
+ * walk change) and its coordinates, which can be passed straight to map_erase
+ * or map_edit.
+ */
+typedef struct {
+    MapItem* item;
+    int x, y;
+} MapCell;
+
+/**
+ * Fills in out with the tiles of map m whose bit in the walkability bitset has
+ * flipped since map_walk_generation(m) returned gen, oldest first and a tile
+ * once for each flip, with item NULL. Returns how many there are, or -1 if
+ * there are more than max, or more than the map remembers (the last 16). Then
+ * anything computed from the bitset at gen has to start over.
+ *
+ * An NPC taking a step flips two bits, so a flow field can be brought up to
+ * date around just those tiles (see path.h).
+ */
+int map_walk_changes(Map* m, unsigned gen, MapCell* out, int max);
+
+/**
+ * The 3x3 block of tiles centred on (x,y), in row-major order. Use the NB_*
+ * indices to pick a cell out of cells.
+ */
+typedef struct {
+    MapCell cells[9];
+} MapNeighbourhood;
+
+#define NB_NORTH 1
+#define NB_WEST  3
+#define NB_HERE  4
+#define NB_EAST  5
+#define NB_SOUTH 7
+
+/**
+ * Fill nb with the 3x3 neighbourhood of (x,y) in the active map, in one pass.
+ */
+void map_neighbours(int x, int y, MapNeighbourhood* nb);
+
+/**
+ * Returns the first cell of nb holding a MapItem of the given type, looking
+ * north, west, east and south of the centre, and then at the centre itself if
+ * on is true. Returns NULL if there is none.
+ */
+MapCell* map_find_near(MapNeighbourhood* nb, int type, int on);
+
+/**
+ * Finds the MapItem of the given type nearest to (x,y) in the active map, by
+ * straight-line distance, and fills in *out. Of items at the same distance,
+ * the first in row-major order is the one found. Returns true if there is one.
+ * For minimaps, quest markers and NPCs picking a target.
+ *
+ * Each map keeps an index of its NPC, KEY, DOOR, STAIRS and WIN_ITEM items by
+ * type and by 16x16 block of the map, so this only looks at the blocks around
+ * (x,y) out to the nearest match. Walls and plants are not indexed, and for
+ * them this always returns false.
+ */
+int map_find_nearest(int type, int x, int y, MapCell* out);
+
+/**
+ * Finds the MapItems of the given type in the w by h rectangle of the active
+ * map with its top left corner at (x0,y0), and fills in up to max of them in
+ * out, in no particular order. Returns how many there are, which can be more
+ * than max. Only the index blocks overlapping the rectangle are looked at; the
+ * indexed types are as for map_find_nearest.
+ */
+int map_find_in_rect(int type, int x0, int y0, int w, int h, MapCell* out, int max);
+
 // Directions, for using the modification functions
 #define HORIZONTAL  0
 #define VERTICAL    1
@@ -142,6 +354,9 @@ void map_erase(int x, int y);
 
 /**
  * If there is a MapItem at (x,y), remove it from the map and return its value.
+ * For a stateless tile this is the shared prototype. Overlay items belong to
+ * the map's memory and stay valid until the map is destroyed. Neither may be
+ * freed.
  */
 void* map_remove(int x, int y);
 
@@ -152,10 +367,18 @@ void* map_remove(int x, int y);
  * If dir == VERTICAL, the line is in the direction of increasing y.
  *
  * If there are already items in the map that collide with this line, they are
- * erased.
+ * erased. The line is clipped to the map, and is written a run of tiles at a
+ * time, so a long wall costs little more than a short one.
  */
 void add_wall(int x, int y, int dir, int len);
 
+/**
+ * Add WALL items around the edge of the w by h rectangle with its top left
+ * corner at (x,y), like the border of a map or the walls of a room. Items
+ * already there are erased, as for add_wall.
+ */
+void add_wall_rect(int x, int y, int w, int h);
+
 /**
  * Add a PLANT item at (x,y). If there is already a MapItem at (x,y), erase it
  * before adding the plant.
@@ -204,4 +427,56 @@ void add_maze(int x, int y, const char* maze);
  */
 void remove_maze(int x, int y, const char* maze);
 
+// Size of a maze layout: MAZE_W x MAZE_H chars, row-major, 'w' for a wall
+#define MAZE_W 11
+#define MAZE_H 11
+#define MAZE_CELLS (MAZE_W * MAZE_H)
+
+/**
+ * The cells that differ between two maze layouts, as indices (y * MAZE_W + x)
+ * into the layout. Changing the maze on the map from one layout to the other
+ * only needs to touch these cells.
+ */
+typedef struct {
+    int count;
+    unsigned char cells[MAZE_CELLS];
+} MazeDiff;
+
+/**
+ * Fills in diff with the cells that differ between the layouts from and to.
+ */
+void maze_diff(const char* from, const char* to, MazeDiff* diff);
+
+/**
+ * Changes the maze at (x,y) of the active map to the layout to, touching only
+ * the cells in diff (from maze_diff, with to as its second layout). Returns
+ * how many tiles changed.
+ */
+int maze_apply(int x, int y, const char* to, const MazeDiff* diff);
+
+/**
+ * A maze at (x,y) that shifts through a cycle of n layouts. diffs holds one
+ * MazeDiff per layout: diffs[i] takes states[i] to states[(i + 1) % n], so a
+ * dungeon with many states costs one diff each, computed once.
+ */
+typedef struct {
+    int x, y;
+    const char** states;
+    MazeDiff* diffs;
+    int n;
+    int current;
+} MazeChain;
+
+/**
+ * Sets up chain for the n layouts in states at (x,y), computing its diffs into
+ * diffs (room for n), and adds the first layout to the active map.
+ */
+void maze_chain_init(MazeChain* chain, int x, int y, const char** states, int n, MazeDiff* diffs);
+
+/**
+ * Shifts chain's maze on the active map to its next layout, and returns how
+ * many tiles changed.
+ */
+int maze_chain_step(MazeChain* chain);
+
 #endif //MAP_H
@@ -0,0 +1,610 @@
+#include "path.h"
+
+#include "globals.h"
+#include "map.h"
+
+/**
+ * A flow field toward one target. Each of the bitsets below is laid out like
+ * the map's walkability bitset: stride 32-bit words per row, bit (x % 32) of
+ * word x / 32 for tile x.
+ *
+ * reach has a bit set for every tile with a path to the target. The direction
+ * of the first step from such a tile is PATH_NORTH..PATH_WEST, stored as two
+ * bit planes: bit 0 in dir_lo and bit 1 in dir_hi. Its distance to the target
+ * mod 3 is stored the same way in mod_lo and mod_hi, for local repair.
+ */
+typedef struct {
+    Map* map;           // Map the field was built on, or NULL if unused
+    unsigned gen;       // map_walk_generation of the map it is up to date with
+    unsigned used;      // Last use, for evicting the least recently used field
+    int tx, ty;         // Target
+    int w, h, stride;
+    int words;          // Words allocated for each bitset
+    unsigned* reach;
+    unsigned* dir_lo;
+    unsigned* dir_hi;
+    unsigned* mod_lo;
+    unsigned* mod_hi;
+} FlowField;
+
+/**
+ * The flow field cache. A couple of fields covers a target that moves (the
+ * player) plus one that does not (a door).
+ */
+#define FLOW_FIELDS 2
+static FlowField fields[FLOW_FIELDS];
+static unsigned use_clock = 0;
+static unsigned builds = 0, repairs = 0;
+
+/**
+ * The BFS frontier, double buffered: the tiles reached on the last layer, and
+ * the tiles being reached on this one. Repairs use front to mark the tiles
+ * they visit, and base for the walkability bitset as the field last saw it.
+ * Shared by every field and grown to fit the largest map searched; one block,
+ * scratch, holds all three.
+ */
+static unsigned* scratch = NULL;
+static unsigned* front = NULL;
+static unsigned* next = NULL;
+static unsigned* base = NULL;
+static int scratch_words = 0;
+
+/**
+ * Makes sure field f and the scratch bitsets have room for n words per
+ * bitset. Returns false if there is not enough memory.
+ */
+static int reserve(FlowField* f, int n)
+{
+    if (n > scratch_words)
+    {
+        free(scratch);
+        scratch = (unsigned*) malloc(3 * n * sizeof(unsigned));
+        if (!scratch)
+        {
+            front = next = base = NULL;
+            scratch_words = 0;
+            return false;
+        }
+        // The frontier buffers are kept clear between searches
+        memset(scratch, 0, 2 * n * sizeof(unsigned));
+        front = scratch;
+        next = scratch + n;
+        base = scratch + 2 * n;
+        scratch_words = n;
+    }
+    if (n > f->words)
+    {
+        free(f->reach);
+        f->reach = (unsigned*) malloc(5 * n * sizeof(unsigned));
+        if (!f->reach)
+        {
+            f->words = 0;
+            f->map = NULL;
+            return false;
+        }
+        f->dir_lo = f->reach + n;
+        f->dir_hi = f->dir_lo + n;
+        f->mod_lo = f->dir_hi + n;
+        f->mod_hi = f->mod_lo + n;
+        f->words = n;
+    }
+    return true;
+}
+
+/**
+ * Fills in field f toward (f->tx, f->ty) over the walkability bitset walk,
+ * and returns the number of BFS layers.
+ *
+ * Each layer expands the whole frontier at once. For each word of a row, the
+ * frontier words above and below, and the row's own frontier shifted one bit
+ * each way, give the tiles next to the frontier, 32 at a time. Tiles not
+ * reached before are reached now, and their direction is toward the frontier
+ * tile they were reached from. Only walkable tiles join the next frontier, so
+ * an unwalkable tile (like a closed door) gets a direction but paths never
+ * pass through it.
+ *
+ * Rows more than one away from the frontier cannot change, so each layer only
+ * scans the rows from one above the frontier to one below it.
+ */
+static int flood(FlowField* f, const unsigned* walk)
+{
+    int s = f->stride;
+    int n = s * f->h;
+    memset(f->reach, 0, n * sizeof(unsigned));
+    memset(f->dir_lo, 0, n * sizeof(unsigned));
+    memset(f->dir_hi, 0, n * sizeof(unsigned));
+    memset(f->mod_lo, 0, n * sizeof(unsigned));
+    memset(f->mod_hi, 0, n * sizeof(unsigned));
+
+    // Bits past the width are never reached
+    unsigned edge = (f->w & 31) ? ~((1u << (f->w & 31)) - 1) : 0;
+
+    // The target is the first frontier, walkable or not
+    int t = f->ty * s + (f->tx >> 5);
+    f->reach[t] = front[t] = 1u << (f->tx & 31);
+    int top = f->ty, bottom = f->ty;
+
+    int layers = 0;
+    while (top <= bottom)
+    {
+        // The tiles reached on this layer are layers + 1 from the target
+        int mod = (layers + 1) % 3;
+        int y0 = (top > 0) ? top - 1 : 0;
+        int y1 = (bottom < f->h - 1) ? bottom + 1 : f->h - 1;
+        int new_top = f->h, new_bottom = -1;
+        for (int y = y0; y <= y1; y++)
+        {
+            const unsigned* here = front + y * s;
+            const unsigned* above = (y > 0) ? here - s : NULL;
+            const unsigned* below = (y < f->h - 1) ? here + s : NULL;
+            int row_has_frontier = false;
+            for (int i = 0; i < s; i++)
+            {
+                // Most words are nowhere near the frontier
+                if (!(here[i] | (above ? above[i] : 0) | (below ? below[i] : 0)
+                      | (i > 0 ? here[i - 1] : 0) | (i + 1 < s ? here[i + 1] : 0)))
+                    continue;
+                int k = y * s + i;
+                unsigned seen = f->reach[k];
+                if (i == s - 1) seen |= edge;
+
+                // Tiles next to the frontier, by the direction to step in
+                unsigned north = above ? above[i] & ~seen : 0;
+                unsigned south = below ? below[i] & ~seen & ~north : 0;
+                seen |= north | south;
+                unsigned east = ((here[i] >> 1) | (i + 1 < s ? here[i + 1] << 31 : 0)) & ~seen;
+                seen |= east;
+                unsigned west = ((here[i] << 1) | (i > 0 ? here[i - 1] >> 31 : 0)) & ~seen;
+
+                unsigned reached = north | south | east | west;
+                if (!reached) continue;
+                f->reach[k] |= reached;
+                f->dir_lo[k] |= east | west;   // PATH_EAST, PATH_WEST
+                f->dir_hi[k] |= south | west;  // PATH_SOUTH, PATH_WEST
+                if (mod & 1) f->mod_lo[k] |= reached;
+                if (mod & 2) f->mod_hi[k] |= reached;
+                next[k] = reached & walk[k];
+                if (next[k]) row_has_frontier = true;
+            }
+            if (row_has_frontier)
+            {
+                if (y < new_top) new_top = y;
+                new_bottom = y;
+            }
+        }
+
+        // Clear the old frontier, so the buffers swap clean
+        memset(front + top * s, 0, (bottom - top + 1) * s * sizeof(unsigned));
+        unsigned* swap = front;
+        front = next;
+        next = swap;
+        top = new_top;
+        bottom = new_bottom;
+        layers++;
+    }
+    return layers;
+}
+
+int path_build(const unsigned* walk, int stride, int w, int h, int tx, int ty)
+{
+    FlowField f;
+    memset(&f, 0, sizeof(f));
+    f.tx = tx;
+    f.ty = ty;
+    f.w = w;
+    f.h = h;
+    f.stride = stride;
+    if (!reserve(&f, stride * h)) return -1;
+    int layers = flood(&f, walk);
+    free(f.reach);
+    return layers;
+}
+
+/**
+ * Local repair. When the map's walkability changes, get_field asks the map
+ * which tiles flipped (map_walk_changes), and repairs the field around each of
+ * them in turn rather than flooding it again:
+ *
+ * - A tile that becomes walkable can only make paths shorter. A search from it
+ *   visits the tiles that are now closer to the target, and stops at the rest.
+ * - A tile that becomes unwalkable can only make paths longer, and only those
+ *   of the tiles whose path went through it. Those are found by following the
+ *   directions backwards; the ones with no other way as short are searched
+ *   again from the tiles around them.
+ *
+ * A flip that no path went through, or out of reach of the target, costs next
+ * to nothing. An NPC's step flips two tiles, and visits a handful.
+ *
+ * Both need distances to the target, which the field only has mod 3. That
+ * tells which of d - 1, d or d + 1 a walkable tile next to one d away is,
+ * and following the directions from any tile gives its distance in full.
+ * A repair that would visit more than REPAIR_TILES tiles (a door between two
+ * halves of the map, say) gives up, and the field is flooded again.
+ */
+#define REPAIR_TILES 128
+#define REPAIR_FLIPS 16
+#define FAR          0x7FFFFFFF  // Distance of a tile with no path
+
+typedef struct {
+    unsigned short x, y;
+    int old;                // Distance before the flip, or -1 if unknown or none
+    int d;                  // Distance after the flip, or FAR
+    short next[4];          // Index of the region tile in each direction, or -1
+    unsigned char dir;      // Direction of the first step
+    unsigned char done;
+} RepairTile;
+
+// In the second AHB SRAM bank, next to the map's chunk frames
+static RepairTile region[REPAIR_TILES] __attribute__((section("AHBSRAM1")));
+
+// Steps for PATH_NORTH..PATH_WEST; the opposite of direction d is d ^ 2
+static const int step_x[4] = { 0, 1, 0, -1 };
+static const int step_y[4] = { -1, 0, 1, 0 };
+
+static int get_bit(const unsigned* set, int s, int x, int y)
+{
+    return (set[y * s + (x >> 5)] >> (x & 31)) & 1;
+}
+
+static void put_bit(unsigned* set, int s, int x, int y, int on)
+{
+    if (on) set[y * s + (x >> 5)] |= 1u << (x & 31);
+    else set[y * s + (x >> 5)] &= ~(1u << (x & 31));
+}
+
+static int get_dir(const FlowField* f, int x, int y)
+{
+    return get_bit(f->dir_lo, f->stride, x, y) | (get_bit(f->dir_hi, f->stride, x, y) << 1);
+}
+
+/**
+ * Returns true if (x,y) is on field f's map and is not its target.
+ */
+static int repairable(const FlowField* f, int x, int y)
+{
+    return x >= 0 && x < f->w && y >= 0 && y < f->h && (x != f->tx || y != f->ty);
+}
+
+/**
+ * Marks (x,y) of field f as reached, d away from the target with its first
+ * step in direction dir.
+ */
+static void put_tile(FlowField* f, int x, int y, int dir, int d)
+{
+    int s = f->stride;
+    put_bit(f->reach, s, x, y, true);
+    put_bit(f->dir_lo, s, x, y, dir & 1);
+    put_bit(f->dir_hi, s, x, y, dir >> 1);
+    put_bit(f->mod_lo, s, x, y, (d % 3) & 1);
+    put_bit(f->mod_hi, s, x, y, (d % 3) >> 1);
+}
+
+/**
+ * Returns the distance of reached tile (x,y) of field f to the target, by
+ * following its directions.
+ */
+static int distance(const FlowField* f, int x, int y)
+{
+    int d = 0;
+    while (x != f->tx || y != f->ty)
+    {
+        int dir = get_dir(f, x, y);
+        x += step_x[dir];
+        y += step_y[dir];
+        d++;
+    }
+    return d;
+}
+
+/**
+ * Returns the distance of reached walkable tile (x,y) of field f, next to a
+ * reached walkable tile d away.
+ */
+static int near_distance(const FlowField* f, int x, int y, int d)
+{
+    int s = f->stride;
+    int mod = get_bit(f->mod_lo, s, x, y) | (get_bit(f->mod_hi, s, x, y) << 1);
+    int r = (mod - d % 3 + 3) % 3;
+    return (r == 0) ? d : (r == 1) ? d + 1 : d - 1;
+}
+
+/**
+ * Clears the marks in front of the first n tiles of region.
+ */
+static void unmark(FlowField* f, int n)
+{
+    for (int i = 0; i < n; i++)
+        put_bit(front, f->stride, region[i].x, region[i].y, false);
+}
+
+/**
+ * Repairs field f after (x,y) became walkable in base. Returns false if it
+ * needs flooding again.
+ *
+ * This is a breadth-first search from (x,y) that only goes on through tiles it
+ * brings closer. Their old distance comes from their neighbour the search came
+ * from, by near_distance, except around (x,y) itself, which was not walkable.
+ */
+static int repair_opened(FlowField* f, int x, int y)
+{
+    int s = f->stride;
+    if (!repairable(f, x, y) || !get_bit(f->reach, s, x, y)) return true;
+
+    // It keeps its distance and direction, but needs its distance mod 3 now
+    int d = distance(f, x, y);
+    put_tile(f, x, y, get_dir(f, x, y), d);
+    region[0].x = x;
+    region[0].y = y;
+    region[0].old = -1;
+    region[0].d = d;
+    put_bit(front, s, x, y, true);
+    int n = 1;
+    for (int i = 0; i < n; i++)
+    {
+        RepairTile* t = &region[i];
+        d = t->d + 1;
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int nx = t->x + step_x[dir], ny = t->y + step_y[dir];
+            if (!repairable(f, nx, ny) || get_bit(front, s, nx, ny)) continue;
+            int reached = get_bit(f->reach, s, nx, ny);
+            if (!get_bit(base, s, nx, ny))
+            {
+                // Paths end here, so it is only checked for a better direction
+                if (!reached || distance(f, nx, ny) > d) put_tile(f, nx, ny, dir ^ 2, d);
+                continue;
+            }
+            int old = FAR;
+            if (reached) old = (t->old >= 0) ? near_distance(f, nx, ny, t->old) : distance(f, nx, ny);
+            if (d >= old) continue;
+            if (n == REPAIR_TILES)
+            {
+                unmark(f, n);
+                return false;
+            }
+            put_tile(f, nx, ny, dir ^ 2, d);
+            put_bit(front, s, nx, ny, true);
+            region[n].x = nx;
+            region[n].y = ny;
+            region[n].old = (old == FAR) ? -1 : old;
+            region[n].d = d;
+            n++;
+        }
+    }
+    unmark(f, n);
+    return true;
+}
+
+/**
+ * Returns the index of (x,y) among the first n tiles of region.
+ */
+static int region_index(int x, int y, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (region[i].x == x && region[i].y == y) return i;
+    return -1;
+}
+
+/**
+ * Returns true if tile (x,y) of field f, old away from the target, has a
+ * neighbour other than the one in direction not that is a step closer and
+ * that paths can go on through (and that is not marked in front), and if so
+ * points it there.
+ */
+static int repoint(FlowField* f, int x, int y, int old, int not_dir)
+{
+    int s = f->stride;
+    int walkable = get_bit(base, s, x, y);
+    for (int dir = 0; dir < 4; dir++)
+    {
+        int nx = x + step_x[dir], ny = y + step_y[dir];
+        if (dir == not_dir || nx < 0 || nx >= f->w || ny < 0 || ny >= f->h) continue;
+        int d;
+        if (nx == f->tx && ny == f->ty) d = 0;
+        else if (!get_bit(f->reach, s, nx, ny) || !get_bit(base, s, nx, ny) || get_bit(front, s, nx, ny)) continue;
+        else d = walkable ? near_distance(f, nx, ny, old) : distance(f, nx, ny);
+        if (d == old - 1)
+        {
+            put_bit(f->dir_lo, s, x, y, dir & 1);
+            put_bit(f->dir_hi, s, x, y, dir >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Repairs field f after (x,y) became unwalkable in base. Returns false if it
+ * needs flooding again.
+ *
+ * Only the tiles whose path went through (x,y), its subtree, can get further
+ * from the target, and most of those have another way just as short. Going
+ * down the subtree a distance at a time, a tile with a neighbour a step closer
+ * (that is not itself cut off) is pointed at it, and the tiles past it keep
+ * their paths. The rest, the tiles cut off, are searched again, shortest
+ * distance first, from the tiles around them.
+ */
+static int repair_blocked(FlowField* f, int x, int y)
+{
+    int s = f->stride;
+    if (!repairable(f, x, y) || !get_bit(f->reach, s, x, y)) return true;
+
+    // The tiles cut off, with their old distances
+    int n = 0, d = -1;
+    for (int i = -1; i < n; i++)
+    {
+        int px = (i < 0) ? x : region[i].x;
+        int py = (i < 0) ? y : region[i].y;
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int nx = px + step_x[dir], ny = py + step_y[dir];
+            if (!repairable(f, nx, ny) || !get_bit(f->reach, s, nx, ny)) continue;
+            if (get_dir(f, nx, ny) != (dir ^ 2)) continue;
+            if (d < 0) d = distance(f, x, y);
+            int old = ((i < 0) ? d : region[i].old) + 1;
+            if (repoint(f, nx, ny, old, dir ^ 2)) continue;
+            if (n == REPAIR_TILES)
+            {
+                unmark(f, n);
+                return false;
+            }
+            region[n].x = nx;
+            region[n].y = ny;
+            region[n].old = old;
+            region[n].d = FAR;
+            region[n].done = false;
+            put_bit(front, s, nx, ny, true);
+            n++;
+        }
+    }
+
+    // Link them up, and start each from its best neighbour that is not
+    for (int i = 0; i < n; i++)
+    {
+        RepairTile* r = &region[i];
+        int walkable = get_bit(base, s, r->x, r->y);
+        for (int dir = 0; dir < 4; dir++)
+        {
+            r->next[dir] = -1;
+            int nx = r->x + step_x[dir], ny = r->y + step_y[dir];
+            if (nx < 0 || nx >= f->w || ny < 0 || ny >= f->h) continue;
+            if (get_bit(front, s, nx, ny))
+            {
+                r->next[dir] = region_index(nx, ny, n);
+                continue;
+            }
+            if (nx == f->tx && ny == f->ty) d = 0;
+            else if (!get_bit(f->reach, s, nx, ny) || !get_bit(base, s, nx, ny)) continue;
+            else d = walkable ? near_distance(f, nx, ny, r->old) : distance(f, nx, ny);
+            if (d + 1 < r->d)
+            {
+                r->d = d + 1;
+                r->dir = dir;
+            }
+        }
+    }
+
+    // Then settle them closest first, as the flood would
+    for (;;)
+    {
+        RepairTile* r = NULL;
+        for (int i = 0; i < n; i++)
+            if (!region[i].done && region[i].d != FAR && (!r || region[i].d < r->d)) r = &region[i];
+        if (!r) break;
+        r->done = true;
+        if (!get_bit(base, s, r->x, r->y)) continue;
+        for (int dir = 0; dir < 4; dir++)
+        {
+            if (r->next[dir] < 0) continue;
+            RepairTile* q = &region[r->next[dir]];
+            if (!q->done && r->d + 1 < q->d)
+            {
+                q->d = r->d + 1;
+                q->dir = dir ^ 2;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        RepairTile* r = &region[i];
+        if (r->d != FAR) put_tile(f, r->x, r->y, r->dir, r->d);
+        else put_bit(f->reach, s, r->x, r->y, false);
+    }
+    unmark(f, n);
+    return true;
+}
+
+/**
+ * Brings field f up to date with map m by repairing it around each tile whose
+ * walkability flipped since. Returns false if it needs flooding again.
+ */
+static int repair(FlowField* f, Map* m)
+{
+    MapCell flips[REPAIR_FLIPS];
+    int n = map_walk_changes(m, f->gen, flips, REPAIR_FLIPS);
+    if (n < 0) return false;
+
+    // base is the bitset as the field saw it, and takes the flips one by one
+    int s = f->stride;
+    memcpy(base, map_walk_row(m, 0), s * f->h * sizeof(unsigned));
+    for (int i = 0; i < n; i++)
+        base[flips[i].y * s + (flips[i].x >> 5)] ^= 1u << (flips[i].x & 31);
+    for (int i = 0; i < n; i++)
+    {
+        int x = flips[i].x, y = flips[i].y;
+        base[y * s + (x >> 5)] ^= 1u << (x & 31);
+        int ok = get_bit(base, s, x, y) ? repair_opened(f, x, y) : repair_blocked(f, x, y);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the cached field toward (tx,ty) on the active map, building it if it
+ * is missing, and bringing it up to date if the map's walkability has changed
+ * since it was last used. Returns NULL if there is not enough memory.
+ */
+static FlowField* get_field(int tx, int ty)
+{
+    Map* m = get_active_map();
+    unsigned gen = map_walk_generation(m);
+
+    // Look for the field, or else take the least recently used one
+    FlowField* f = &fields[0];
+    for (int i = 0; i < FLOW_FIELDS; i++)
+    {
+        FlowField* g = &fields[i];
+        if (g->map == m && g->tx == tx && g->ty == ty)
+        {
+            f = g;
+            break;
+        }
+        if (g->used < f->used) f = g;
+    }
+    f->used = ++use_clock;
+    if (f->map == m && f->tx == tx && f->ty == ty)
+    {
+        if (f->gen == gen) return f;
+        if (repair(f, m))
+        {
+            f->gen = gen;
+            repairs++;
+            return f;
+        }
+    }
+
+    f->map = NULL;
+    f->w = map_width();
+    f->h = map_height();
+    f->stride = map_walk_stride(m);
+    if (!reserve(f, f->stride * f->h)) return NULL;
+    f->tx = tx;
+    f->ty = ty;
+    flood(f, map_walk_row(m, 0));
+    f->map = m;
+    f->gen = gen;
+    builds++;
+    return f;
+}
+
+int path_step(int tx, int ty, int x, int y)
+{
+    if (x == tx && y == ty) return PATH_NONE;
+    if (tx < 0 || tx >= map_width() || ty < 0 || ty >= map_height()) return PATH_NONE;
+    if (x < 0 || x >= map_width() || y < 0 || y >= map_height()) return PATH_NONE;
+
+    FlowField* f = get_field(tx, ty);
+    if (!f) return PATH_NONE;
+
+    int k = y * f->stride + (x >> 5);
+    unsigned bit = 1u << (x & 31);
+    if (!(f->reach[k] & bit)) return PATH_NONE;
+    return ((f->dir_lo[k] & bit) ? 1 : 0) | ((f->dir_hi[k] & bit) ? 2 : 0);
+}
+
+void path_stats(unsigned* built, unsigned* repaired)
+{
+    *built = builds;
+    *repaired = repairs;
+}
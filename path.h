@@ -0,0 +1,51 @@
+#ifndef PATH_H
+#define PATH_H
+
+/**
+ * Pathfinding over the active map's walkability bitset (see map_walk_row).
+ *
+ * A flow field holds, for every tile that has a path to a target, the
+ * direction of the first step along the shortest path. It is built once by a
+ * breadth-first search that expands the whole frontier a 32-tile word at a
+ * time, and then any number of characters can path toward the target by
+ * lookup. Fields are cached. The next time a cached field is used after the
+ * map's walkability changes, it is repaired around just the tiles that changed
+ * (see map_walk_changes), so an NPC's step costs a small search around it,
+ * and a change that no path goes through next to nothing. After changes too
+ * big for that (add_maze, remove_maze, a door into a part of the map the
+ * target could not reach, ...) it is built again. Paths go around NPCs, which
+ * are not walkable.
+ */
+
+// Directions returned by path_step
+#define PATH_NONE  -1
+#define PATH_NORTH  0
+#define PATH_EAST   1
+#define PATH_SOUTH  2
+#define PATH_WEST   3
+
+/**
+ * Returns the direction of the first step from (x,y) along a shortest path to
+ * (tx,ty) on the active map, or PATH_NONE if (x,y) is the target or there is
+ * no path. Paths only pass through walkable tiles, but (x,y) and (tx,ty)
+ * themselves do not need to be walkable, so a character can path to a closed
+ * door.
+ */
+int path_step(int tx, int ty, int x, int y);
+
+/**
+ * Builds a flow field toward (tx,ty) over a w by h walkability bitset laid out
+ * like the map's (stride words per row, bits past the width clear), without
+ * caching it, and returns the number of BFS layers it took. This is the same
+ * search path_step runs, for timing it on grids other than the active map.
+ * Returns -1 if there is not enough memory.
+ */
+int path_build(const unsigned* walk, int stride, int w, int h, int tx, int ty);
+
+/**
+ * Returns how many times path_step has built a flow field from scratch in
+ * built, and how many times it has repaired one in repaired, since startup.
+ */
+void path_stats(unsigned* built, unsigned* repaired);
+
+#endif // PATH_H
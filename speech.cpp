@@ -3,6 +3,7 @@
 #include "globals.h"
 #include "hardware.h"
 #include "graphics.h"
+#include "lcd.h"
 
 /**
  * Draw the speech bubble background.
@@ -31,6 +32,8 @@ static void speech_bubble_wait();
 
 void draw_speech_bubble()
 {
+    // Finish drawing the frame under the bubble first
+    lcd_fence();
     uLCD.rectangle(0, 93, 127, 115, YELLOW);
     uLCD.filled_rectangle(1, 94, 126, 114, BLACK);
 }
@@ -38,6 +41,9 @@ void draw_speech_bubble()
 void erase_speech_bubble()
 {
     uLCD.filled_rectangle(0, 93, 127, 115, BLACK);
+
+    // The bubble and its flashing button covered these tiles and the border
+    forget_screen(0, 93, 127, 117);
     draw_border();
 }
 
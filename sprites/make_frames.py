@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Builds frames.h, the sprite store, from the PNGs in this directory.
+
+Each 11x11 sprite is stored as a palette of up to 16 RGB565 colours and a
+4-bit palette index per pixel, so the whole store is const data that stays in
+flash. Transparent pixels are black, like the rest of the background.
+
+Usage (from the project root):
+    python3 sprites/make_frames.py > frames.h
+
+Only the standard library is used, so the PNGs must be 8-bit RGB or RGBA and
+not interlaced, which is how they are saved.
+"""
+
+import os
+import struct
+import sys
+import zlib
+
+SIZE = 11
+
+# The sprites in frames.h order; graphics.cpp refers to them by index
+SPRITES = [
+    ("appleTree.png", "apple tree"),
+    ("door_closed.png", "door closed"),
+    ("door_open.png", "door open"),
+    ("key.png", "key"),
+    ("npc.png", "NPC"),
+    ("playerBig.png", "Player"),
+    ("playerWithKey.png", "Player with key"),
+    ("stairs.png", "stairs"),
+    ("wall.png", "wall"),
+    ("throne.png", "throne"),
+]
+
+
+def read_png(path):
+    """Returns the pixels of a PNG as a list of rows of (r, g, b, a)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        sys.exit("%s: not a PNG" % path)
+
+    pos = 8
+    idat = b""
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            w, h, depth, colour, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+    if depth != 8 or colour not in (2, 6) or interlace:
+        sys.exit("%s: only 8-bit RGB/RGBA, not interlaced" % path)
+
+    bpp = 4 if colour == 6 else 3
+    raw = zlib.decompress(idat)
+    stride = w * bpp
+    rows = []
+    prev = bytearray(stride)
+    for y in range(h):
+        start = y * (stride + 1)
+        kind = raw[start]
+        line = bytearray(raw[start + 1:start + 1 + stride])
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + (a + b) // 2) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[i] = (line[i] + pred) & 0xFF
+        rows.append([tuple(line[x * bpp:x * bpp + bpp]) + ((255,) if bpp == 3 else ())
+                     for x in range(w)])
+        prev = line
+    return rows
+
+
+def rgb565(pixel):
+    r, g, b, a = pixel
+    if a == 0:
+        return 0
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+
+
+def encode(path):
+    """Returns (palette, packed indices) for one sprite."""
+    rows = read_png(path)
+    if len(rows) != SIZE or len(rows[0]) != SIZE:
+        sys.exit("%s: sprites are %dx%d" % (path, SIZE, SIZE))
+    palette = []
+    indices = []
+    for row in rows:
+        for pixel in row:
+            c = rgb565(pixel)
+            if c not in palette:
+                palette.append(c)
+            indices.append(palette.index(c))
+    if len(palette) > 16:
+        sys.exit("%s: %d colours, at most 16 fit" % (path, len(palette)))
+    palette += [0] * (16 - len(palette))
+    indices.append(0)  # Pad to a whole byte
+    packed = [indices[i] | (indices[i + 1] << 4) for i in range(0, len(indices), 2)]
+    return palette, packed
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    out = sys.stdout
+    out.write("// Generated by sprites/make_frames.py from the PNGs in sprites/. Do not edit.\n")
+    out.write("\n")
+    out.write("/**\n")
+    out.write(" * An 11x11 sprite: a palette of up to 16 RGB565 colours, and a 4-bit palette\n")
+    out.write(" * index for each pixel in row-major order, two to a byte, low nibble first.\n")
+    out.write(" */\n")
+    out.write("typedef struct {\n")
+    out.write("    unsigned short palette[16];\n")
+    out.write("    unsigned char pixels[(11*11 + 1) / 2];\n")
+    out.write("} Sprite;\n")
+    out.write("\n")
+    out.write("static const Sprite sprite_frames[%d] = {\n" % len(SPRITES))
+    for n, (name, label) in enumerate(SPRITES):
+        palette, packed = encode(os.path.join(here, name))
+        out.write("//%d %s\n" % (n, label))
+        out.write("{\n{ ")
+        out.write(", ".join("0x%04x" % c for c in palette))
+        out.write(" },\n{\n")
+        for i in range(0, len(packed), 16):
+            out.write(", ".join("0x%02x" % b for b in packed[i:i + 16]) + ",\n")
+        out.write("}\n},\n")
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+/**
+ * Host benchmark of draw_img in graphics.cpp, before and after its colour
+ * table and decode cache.
+ *
+ * draw_img used to decode each of an image's 121 characters through a chain
+ * of six compares. It now looks each one up in a 256-entry colour table, and
+ * keeps the last IMG_CACHE (4) images it decoded, by the address of the image
+ * string, so drawing one of them again skips the decode. Three cases are
+ * timed, drawing the same 11x11 images:
+ *
+ *  - the compare chain, as draw_img was (a copy of it is below);
+ *  - draw_img cycling through 8 images, so every draw misses the cache and
+ *    pays for the table decode;
+ *  - draw_img cycling through 4 images, so every draw hits the cache.
+ *
+ * The LCD queue is stood in for by a copy of the pixels, as lcd_blit makes
+ * into its ring, so the times are the decode and the bookkeeping alone. Each
+ * image is also checked to come out the same all three ways.
+ *
+ * Usage: draw_img_bench [rounds]
+ */
+#include "globals.h"
+#include "graphics.h"
+#include "hardware.h"
+#include "lcd.h"
+#include "world_fixture.h"
+
+uLCD_4DGL uLCD(p9, p10, p11);
+
+GameInputs read_inputs()
+{
+    GameInputs in = { 0, 0, 0, 0, 0, 0 };
+    return in;
+}
+
+// The last pixels sent, copied as lcd_blit copies them into the queue
+static unsigned short sent[11*11];
+
+void lcd_init(int baud) {}
+void lcd_fill(int x0, int y0, int x1, int y1, int color) {}
+void lcd_fence() {}
+
+void lcd_blit(int x, int y, int w, int h, const unsigned short* pixels)
+{
+    memcpy(sent, pixels, sizeof(sent));
+}
+
+// As graphics.cpp has them
+#define YELLOW 0xFFFF00
+#define DIRT   0xD2691E
+
+#define IMAGES 8
+static char images[IMAGES][11*11 + 1];
+
+/**
+ * draw_img as it was before the colour table, compare by compare.
+ */
+static void draw_img_chain(int u, int v, const char* img)
+{
+    unsigned short colors[11*11];
+    for (int i = 0; i < 11*11; i++)
+    {
+        if (img[i] == 'R') colors[i] = RGB565(RED);
+        else if (img[i] == 'Y') colors[i] = RGB565(YELLOW);
+        else if (img[i] == 'G') colors[i] = RGB565(GREEN);
+        else if (img[i] == 'D') colors[i] = RGB565(DIRT);
+        else if (img[i] == '5') colors[i] = RGB565(LGREY);
+        else if (img[i] == '3') colors[i] = RGB565(DGREY);
+        else colors[i] = RGB565(BLACK);
+    }
+    lcd_blit(u, v, 11, 11, colors);
+}
+
+/**
+ * Makes IMAGES different images from one tree, each shifted a little, with
+ * every colour draw_img knows and some characters it does not.
+ */
+static void make_images()
+{
+    static const char tree[] = "....GGG...."
+                               "...GGGGG..."
+                               "..GGRGGRG.."
+                               "..GGGGGGG.."
+                               "...GRGGG..."
+                               ".....D....."
+                               ".....D....."
+                               "....DDD...."
+                               "3333333333 "
+                               "55555555555"
+                               "YYYYYYYYYYY";
+    for (int k = 0; k < IMAGES; k++)
+    {
+        for (int i = 0; i < 11*11; i++)
+            images[k][i] = tree[(i + k * 12) % (11*11)];
+        images[k][11*11] = 0;
+    }
+}
+
+/**
+ * Draws images 0..n-1 in turn, draws times, with draw, and returns the time
+ * per draw in ns.
+ */
+static double time_draws(void (*draw)(int, int, const char*), int n, int draws)
+{
+    double t0 = now_ns();
+    for (int i = 0; i < draws; i++)
+        draw(3, 15, images[i % n]);
+    return (now_ns() - t0) / draws;
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 200000;
+    make_images();
+
+    // Every image comes out the same all three ways: decoded, then cached
+    int failures = 0;
+    for (int pass = 0; pass < 2; pass++)
+        for (int k = 0; k < IMAGES; k++)
+        {
+            unsigned short chain[11*11];
+            draw_img_chain(3, 15, images[k]);
+            memcpy(chain, sent, sizeof(chain));
+            draw_img(3, 15, images[k]);
+            if (memcmp(chain, sent, sizeof(chain))) failures++;
+            draw_img(3, 15, images[k]);
+            if (memcmp(chain, sent, sizeof(chain))) failures++;
+        }
+    if (failures)
+    {
+        printf("draw_img and the compare chain differ on %d draws\n", failures);
+        return 1;
+    }
+
+    printf("draw_img, 11x11 images, ns per draw:\n");
+    printf("  %8.1f  compare chain (before)\n", time_draws(draw_img_chain, IMAGES, rounds));
+    printf("  %8.1f  colour table, cache miss (%d images)\n", time_draws(draw_img, IMAGES, rounds), IMAGES);
+    printf("  %8.1f  cache hit (%d images)\n", time_draws(draw_img, 4, rounds), 4);
+    return 0;
+}
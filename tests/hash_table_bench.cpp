@@ -0,0 +1,72 @@
+/**
+ * Host benchmark of the hash table engines: insert, lookup and remove
+ * throughput of HASH_CHAINED and HASH_OPEN at 50%, 75% and 90% load.
+ *
+ * Load is items per bucket (or slot) of a table created with BUCKETS of them.
+ * Tables resize past their load limit (see hash_table.cpp), so the higher
+ * loads are measured while the table is growing, as they would be in use.
+ * Keys are random, and lookups are all hits.
+ *
+ * Usage: hash_table_bench [rounds]
+ */
+#include "hash_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "world_fixture.h"
+
+#define BUCKETS 4096
+#define LOOKUP_PASSES 4
+
+static unsigned hash_mix(unsigned key)
+{
+    unsigned h = key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 200;
+    static const int loads[] = { 50, 75, 90 };
+    static unsigned keys[BUCKETS];
+    int value;
+    srand(1);
+
+    printf("%d buckets, %d rounds, ns per operation\n", BUCKETS, rounds);
+    for (int mode = HASH_CHAINED; mode <= HASH_OPEN; mode++)
+    {
+        for (int l = 0; l < 3; l++)
+        {
+            unsigned n = BUCKETS * loads[l] / 100;
+            double insert = 0, lookup = 0, remove = 0;
+            for (int r = 0; r < rounds; r++)
+            {
+                for (unsigned i = 0; i < n; i++)
+                    keys[i] = rand();
+                HashTable* t = createHashTable(hash_mix, BUCKETS, mode);
+
+                double t0 = now_ns();
+                for (unsigned i = 0; i < n; i++)
+                    insertItem(t, keys[i], &value);
+                double t1 = now_ns();
+                for (int pass = 0; pass < LOOKUP_PASSES; pass++)
+                    for (unsigned i = 0; i < n; i++)
+                        if (!getItem(t, keys[i])) return 1;
+                double t2 = now_ns();
+                for (unsigned i = 0; i < n; i++)
+                    removeItem(t, keys[i]);
+                double t3 = now_ns();
+
+                insert += t1 - t0;
+                lookup += (t2 - t1) / LOOKUP_PASSES;
+                remove += t3 - t2;
+                destroyHashTable(t);
+            }
+            printf("%-7s load %d%%: insert %6.1f  lookup %6.1f  remove %6.1f\n",
+                   (mode == HASH_OPEN) ? "open" : "chained", loads[l],
+                   insert / rounds / n, lookup / rounds / n, remove / rounds / n);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,419 @@
+/**
+ * Behavioural tests for the hash table engines in hash_table.cpp.
+ *
+ * Each engine is run through the same long random mix of insertItem, getItem,
+ * removeItem and deleteItem calls, and every result is checked against a
+ * plain array of the values that should be in the table. The key ranges and
+ * the phases of mostly inserting and mostly removing make the tables grow and
+ * shrink through several incremental resizes along the way. Values are heap
+ * blocks, so deleteItem and destroyHashTable are checked to free each one
+ * exactly once (run under AddressSanitizer to see that).
+ */
+#include "hash_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+        failures++; \
+    } \
+} while (0)
+
+// A simple multiplicative hash, and one that puts every key in a few buckets
+static unsigned hash_mix(unsigned key)
+{
+    unsigned h = key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static unsigned hash_clump(unsigned key)
+{
+    return key % 7;
+}
+
+// Deterministic, so a failure can be replayed
+static unsigned rng = 1;
+static unsigned next_random()
+{
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) & 0xFFFFFF;
+}
+
+static int* new_value(int v)
+{
+    int* p = (int*) malloc(sizeof(int));
+    *p = v;
+    return p;
+}
+
+/**
+ * Runs a random mix of operations on a table of the given mode against the
+ * reference array expected, with keys below range.
+ */
+static void check_against_reference(const char* name, int mode, unsigned buckets, HashFunction hash,
+                                    unsigned range)
+{
+    void** expected = (void**) calloc(range, sizeof(void*));
+    HashTable* t = createHashTable(hash, buckets, mode);
+    CHECK(t != NULL);
+    rng = 1;
+
+    for (int phase = 0; phase < 6; phase++)
+    {
+        // Even phases mostly insert, odd phases mostly remove
+        int inserts = (phase % 2) ? 1 : 4;
+        for (int i = 0; i < 20000; i++)
+        {
+            unsigned key = next_random() % range;
+            int op = next_random() % 8;
+            if (op < inserts)
+            {
+                int* v = new_value(i);
+                void* old = insertItem(t, key, v);
+                CHECK(old == expected[key]);
+                free(old);
+                expected[key] = v;
+            }
+            else if (op < 5)
+            {
+                CHECK(getItem(t, key) == expected[key]);
+            }
+            else if (op < 7)
+            {
+                void* v = removeItem(t, key);
+                CHECK(v == expected[key]);
+                free(v);
+                expected[key] = NULL;
+            }
+            else
+            {
+                deleteItem(t, key);
+                expected[key] = NULL;
+            }
+        }
+
+        // Every key still reads back right, present or not
+        unsigned count = 0;
+        for (unsigned key = 0; key < range; key++)
+        {
+            CHECK(getItem(t, key) == expected[key]);
+            if (expected[key]) count++;
+        }
+#if HASH_TABLE_STATS
+        HashTableStats stats;
+        hashTableGetStats(t, &stats);
+        CHECK(stats.num_items == count);
+#endif
+    }
+
+    // destroyHashTable frees the values that are left
+    destroyHashTable(t);
+    free(expected);
+    printf("%s: ok\n", name);
+}
+
+/**
+ * An allocator that counts its blocks, to check that a table gives back
+ * everything it takes.
+ */
+static int live_blocks = 0;
+
+static void* counting_alloc(void* context, unsigned size)
+{
+    live_blocks++;
+    return malloc(size);
+}
+
+static void counting_release(void* context, void* block)
+{
+    live_blocks--;
+    free(block);
+}
+
+static void check_allocator(int mode)
+{
+    HashAllocator allocator = { counting_alloc, counting_release, NULL };
+    live_blocks = 0;
+    HashTable* t = createHashTable(hash_mix, 4, mode, &allocator);
+    CHECK(t != NULL);
+
+    // Values come from the allocator too, as its release frees them
+    for (unsigned key = 0; key < 500; key++)
+        insertItem(t, key, counting_alloc(NULL, sizeof(int)));
+    for (unsigned key = 0; key < 500; key += 2)
+        deleteItem(t, key);
+    CHECK(getItem(t, 1) != NULL);
+    CHECK(getItem(t, 2) == NULL);
+    destroyHashTable(t);
+    CHECK(live_blocks == 0);
+    printf("allocator, mode %d: ok\n", mode);
+}
+
+/**
+ * An allocator with no memory, or with room for just the table struct.
+ */
+static int empty_blocks = 0;
+
+static void* empty_alloc(void* context, unsigned size)
+{
+    if (empty_blocks == 0) return NULL;
+    empty_blocks--;
+    live_blocks++;
+    return malloc(size);
+}
+
+static void check_no_memory(int mode)
+{
+    HashAllocator allocator = { empty_alloc, counting_release, NULL };
+    live_blocks = 0;
+    empty_blocks = 0;
+    CHECK(createHashTable(hash_mix, 8, mode, &allocator) == NULL);
+    empty_blocks = 1;
+    CHECK(createHashTable(hash_mix, 8, mode, &allocator) == NULL);
+    CHECK(live_blocks == 0);
+    CHECK(createHashTable(hash_mix, 0, mode) == NULL);
+
+    // A chained table with no memory for an entry slab cannot take a new key,
+    // but it can still replace a value; an open table needs no memory for it
+    empty_blocks = 2;
+    HashTable* t = createHashTable(hash_mix, 8, mode, &allocator);
+    CHECK(t != NULL);
+    int values[2];
+    void* stored = (mode == HASH_OPEN) ? NULL : HASH_NO_MEMORY;
+    CHECK(insertItem(t, 1, &values[0]) == stored);
+    CHECK(getItem(t, 1) == ((mode == HASH_OPEN) ? &values[0] : NULL));
+    empty_blocks = 1;
+    insertItem(t, 1, &values[0]);
+    CHECK(insertItem(t, 1, &values[1]) == &values[0]);
+    CHECK(getItem(t, 1) == &values[1]);
+    removeItem(t, 1);
+    destroyHashTable(t);
+    CHECK(live_blocks == 0);
+    printf("no memory, mode %d: ok\n", mode);
+}
+
+/**
+ * A table that has no memory to grow keeps working at the size it is, and
+ * grows once there is memory again.
+ */
+static void check_failed_resize(int mode)
+{
+    HashAllocator allocator = { empty_alloc, counting_release, NULL };
+    live_blocks = 0;
+    empty_blocks = 2;
+    HashTable* t = createHashTable(hash_mix, 8, mode, &allocator);
+    CHECK(t != NULL);
+    // Entries come from the buffer, so only resizes ask for memory
+    void* buffer[HASH_POOL_BYTES(201) / sizeof(void*)];
+    hashTableUseBuffer(t, buffer, sizeof(buffer));
+
+    // An open table can only hold as many keys as it has slots
+    static int values[201];
+    unsigned room = (mode == HASH_OPEN) ? 8 : 200;
+    for (unsigned key = 0; key < 200; key++)
+        CHECK(insertItem(t, key, &values[key]) == ((key < room) ? NULL : HASH_NO_MEMORY));
+    for (unsigned key = 0; key < 200; key++)
+        CHECK(getItem(t, key) == ((key < room) ? &values[key] : NULL));
+#if HASH_TABLE_STATS
+    HashTableStats stats;
+    hashTableGetStats(t, &stats);
+    CHECK(stats.num_buckets == 8);
+#endif
+
+    // With memory again, the next inserts grow it
+    empty_blocks = 100;
+    for (unsigned key = room; key <= 200; key++)
+        CHECK(insertItem(t, key, &values[key]) == NULL);
+    for (unsigned key = 0; key <= 200; key++)
+        CHECK(getItem(t, key) == &values[key]);
+#if HASH_TABLE_STATS
+    hashTableGetStats(t, &stats);
+    CHECK(stats.num_buckets > 8);
+#endif
+
+    // The values are not the table's to free
+    for (unsigned key = 0; key <= 200; key++)
+        CHECK(removeItem(t, key) == &values[key]);
+    destroyHashTable(t);
+    CHECK(live_blocks == 0);
+    printf("failed resize, mode %d: ok\n", mode);
+}
+
+static void check_pool()
+{
+    // The buffer is used before any slab is taken from the heap
+    void* buffer[HASH_POOL_BYTES(8) / sizeof(void*)];
+    HashTable* t = createHashTable(hash_mix, 8);
+    hashTableUseBuffer(t, buffer, sizeof(buffer));
+    CHECK(hashTablePoolCapacity(t) == 8);
+
+    int values[20];
+    for (unsigned key = 0; key < 8; key++)
+        insertItem(t, key, &values[key]);
+    CHECK(hashTablePoolCapacity(t) == 8);
+    CHECK(hashTablePoolUsed(t) == 8);
+
+    // The ninth entry needs a slab
+    insertItem(t, 8, &values[8]);
+    CHECK(hashTablePoolCapacity(t) > 8);
+    CHECK(hashTablePoolUsed(t) == 9);
+
+    // Removed entries are reused, and the high water mark stays
+    for (unsigned key = 0; key < 9; key++)
+        CHECK(removeItem(t, key) == &values[key]);
+    CHECK(hashTablePoolUsed(t) == 0);
+    CHECK(hashTablePoolHighWater(t) == 9);
+    unsigned capacity = hashTablePoolCapacity(t);
+    for (unsigned key = 0; key < 9; key++)
+        insertItem(t, key + 100, &values[key]);
+    CHECK(hashTablePoolCapacity(t) == capacity);
+
+    // The values are not the table's to free
+    for (unsigned key = 0; key < 9; key++)
+        removeItem(t, key + 100);
+    destroyHashTable(t);
+    printf("entry pool: ok\n");
+}
+
+/**
+ * HashTableVisitor that records the keys it is given, and stops after limit.
+ */
+static int iter_values[1000];
+
+typedef struct {
+    unsigned keys[1000];
+    int count;
+    int limit;
+} Visited;
+
+static int visit_key(unsigned key, void* value, void* context)
+{
+    Visited* v = (Visited*) context;
+    CHECK(key < 1000 && value == &iter_values[key]);
+    v->keys[v->count++] = key;
+    return v->count == v->limit;
+}
+
+/**
+ * The cursor and hashTableForEach visit every item once, and only the items,
+ * also while the table is part way through a resize.
+ */
+static void check_iteration(int mode)
+{
+    static Visited v;
+    HashTable* t = createHashTable(hash_mix, 8, mode);
+    HashTableCursor cursor;
+    unsigned key;
+    void* value;
+
+    // An empty table has nothing to visit
+    hashTableCursorInit(&cursor);
+    CHECK(!hashTableNext(t, &cursor, &key, &value));
+    v.count = 0;
+    v.limit = 0;
+    CHECK(hashTableForEach(t, visit_key, &v, HASH_KEY_ORDER));
+    CHECK(v.count == 0);
+
+    // n keys, every third one, inserted from the top down. Growing from 8
+    // buckets, the table is part way through moving its items to 256
+    // (chained) or 512 (open) buckets when the last one goes in.
+    int n = (mode == HASH_OPEN) ? 200 : 260;
+    for (int i = n - 1; i >= 0; i--)
+        insertItem(t, 3 * i, &iter_values[3 * i]);
+    int seen[1000] = { 0 };
+    int count = 0;
+    hashTableCursorInit(&cursor);
+    while (hashTableNext(t, &cursor, &key, &value))
+    {
+        CHECK(key < 1000 && value == &iter_values[key]);
+        if (key < 1000) seen[key]++;
+        count++;
+    }
+    CHECK(count == n);
+    for (int k = 0; k < 1000; k++)
+        CHECK(seen[k] == (k % 3 == 0 && k < 3 * n));
+
+    // In key order, and the visitor can stop the walk
+    v.count = 0;
+    CHECK(hashTableForEach(t, visit_key, &v, HASH_KEY_ORDER));
+    CHECK(v.count == n);
+    for (int i = 0; i < v.count; i++)
+        CHECK(v.keys[i] == 3u * i);
+    v.count = 0;
+    v.limit = 10;
+    CHECK(hashTableForEach(t, visit_key, &v, HASH_KEY_ORDER));
+    CHECK(v.count == 10 && v.keys[9] == 27);
+    v.count = 0;
+    CHECK(hashTableForEach(t, visit_key, &v, HASH_ANY_ORDER));
+    CHECK(v.count == 10);
+
+    // The values are not the table's to free
+    for (int i = 0; i < n; i++)
+        removeItem(t, 3 * i);
+    destroyHashTable(t);
+    printf("iteration, mode %d: ok\n", mode);
+}
+
+#if HASH_TABLE_STATS
+static void check_stats(int mode)
+{
+    HashTable* t = createHashTable(hash_mix, 64, mode);
+    int value;
+    for (unsigned key = 0; key < 20; key++)
+        insertItem(t, key, &value);
+    hashTableResetStats(t);
+    for (unsigned key = 0; key < 30; key++)
+        getItem(t, key);
+
+    HashTableStats stats;
+    hashTableGetStats(t, &stats);
+    CHECK(stats.num_items == 20);
+    CHECK(stats.gets == 30);
+    CHECK(stats.hits == 20);
+    CHECK(stats.misses == 10);
+    CHECK(stats.probes >= stats.hits);
+    unsigned binned = 0;
+    for (int i = 0; i < HASH_STATS_BINS; i++)
+        binned += stats.histogram[i];
+    // Chained tables count buckets, open tables count items
+    CHECK(binned == ((mode == HASH_OPEN) ? 20u : stats.num_buckets));
+
+    for (unsigned key = 0; key < 20; key++)
+        removeItem(t, key);
+    destroyHashTable(t);
+    printf("stats, mode %d: ok\n", mode);
+}
+#endif
+
+int main()
+{
+    check_against_reference("chained", HASH_CHAINED, 8, hash_mix, 4000);
+    check_against_reference("chained, one bucket", HASH_CHAINED, 1, hash_mix, 30000);
+    check_against_reference("chained, clumped", HASH_CHAINED, 8, hash_clump, 1000);
+    check_against_reference("open", HASH_OPEN, 16, hash_mix, 4000);
+    check_against_reference("open, clumped", HASH_OPEN, 7, hash_clump, 1000);
+    check_allocator(HASH_CHAINED);
+    check_allocator(HASH_OPEN);
+    check_no_memory(HASH_CHAINED);
+    check_no_memory(HASH_OPEN);
+    check_failed_resize(HASH_CHAINED);
+    check_failed_resize(HASH_OPEN);
+    check_pool();
+    check_iteration(HASH_CHAINED);
+    check_iteration(HASH_OPEN);
+#if HASH_TABLE_STATS
+    check_stats(HASH_CHAINED);
+    check_stats(HASH_OPEN);
+#endif
+
+    if (failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * Behavioural tests for the LCD command queue in lcd.cpp, on the simulated
+ * UART in stubs/sim_uart.cpp.
+ *
+ * Rounds of random BLITs (from one pixel up to wider than the ring) and fills
+ * are queued, with random ACK delays and random stretches of time passing
+ * whenever interrupts come back on. The simulated LCD must receive every
+ * command, byte for byte as the protocol encodes it, and in order. It fails
+ * the test itself if a byte arrives before it has replied to the command
+ * before. After each lcd_fence the UART must be quiet, as uLCD needs it.
+ *
+ * lcd_test_small builds the same test with a ring of 32 bytes and 2 commands,
+ * so that nearly every command waits for room.
+ */
+#include "lcd.h"
+
+#include "globals.h"
+#include "sim_uart.h"
+
+static int failures = 0;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+        failures++; \
+    } \
+} while (0)
+
+// Deterministic, so a failure can be replayed
+static unsigned rng = 1;
+static int random_below(int n)
+{
+    rng = rng * 1103515245u + 12345u;
+    return ((rng >> 8) & 0xFFFFFF) % n;
+}
+
+// The bytes each queued command should reach the LCD as
+static std::vector<std::vector<unsigned char> > expected;
+
+static void put16(std::vector<unsigned char>& bytes, int value)
+{
+    bytes.push_back((value >> 8) & 0xFF);
+    bytes.push_back(value & 0xFF);
+}
+
+static void blit(int x, int y, int w, int h)
+{
+    static unsigned short pixels[128 * 40];
+    std::vector<unsigned char> bytes;
+    put16(bytes, 0x000A);
+    put16(bytes, x);
+    put16(bytes, y);
+    put16(bytes, w);
+    put16(bytes, h);
+    for (int i = 0; i < w * h; i++)
+    {
+        pixels[i] = random_below(0x10000);
+        put16(bytes, pixels[i]);
+    }
+    expected.push_back(bytes);
+    lcd_blit(x, y, w, h, pixels);
+}
+
+static void fill(int x0, int y0, int x1, int y1, int color)
+{
+    std::vector<unsigned char> bytes;
+    put16(bytes, 0xFFCE);
+    put16(bytes, x0);
+    put16(bytes, y0);
+    put16(bytes, x1);
+    put16(bytes, y1);
+    put16(bytes, RGB565(color));
+    expected.push_back(bytes);
+    lcd_fill(x0, y0, x1, y1, color);
+}
+
+/**
+ * Checks that the LCD has received every command queued so far, and that the
+ * UART has been handed back.
+ */
+static void check_fenced()
+{
+    CHECK(sim_uart_idle());
+    CHECK(sim_uart_commands.size() == expected.size());
+    for (unsigned i = 0; i < sim_uart_commands.size() && i < expected.size(); i++)
+        CHECK(sim_uart_commands[i] == expected[i]);
+}
+
+static void check_random(unsigned seed, int rounds)
+{
+    rng = seed;
+    for (int round = 0; round < rounds; round++)
+    {
+        sim_uart_ack_delay = 1 + random_below(50);
+        int n = 1 + random_below(40);
+        for (int k = 0; k < n; k++)
+        {
+            if (random_below(3))
+            {
+                // Mostly tiles, and now and then a wide one
+                int wide = !random_below(4);
+                int w = 1 + random_below(wide ? 128 : 11);
+                int h = 1 + random_below(wide ? 40 : 11);
+                blit(random_below(128), random_below(128), w, h);
+            }
+            else
+            {
+                fill(random_below(128), random_below(128), random_below(128), random_below(128),
+                     random_below(0x1000000));
+            }
+        }
+        if (random_below(2))
+        {
+            lcd_fence();
+            check_fenced();
+        }
+    }
+    lcd_fence();
+    check_fenced();
+    printf("seed %u: %u commands, %ld bytes, %ld interrupts: ok\n", seed, (unsigned) expected.size(),
+           sim_uart_bytes, sim_uart_interrupts);
+}
+
+int main()
+{
+    // Fencing before anything is queued, and twice in a row, returns at once
+    lcd_init(3000000);
+    lcd_fence();
+    lcd_fence();
+    check_fenced();
+
+    sim_uart_preempt = 0;
+    check_random(1, 50);
+    sim_uart_preempt = 30;
+    check_random(2, 200);
+    check_random(3, 200);
+    sim_uart_fifo = 1;
+    check_random(4, 50);
+
+    // Some commands had to wait for room in the ring
+    CHECK(lcd_queue_stalls() > 0);
+
+    if (failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * Host benchmark of fetching the map view that draw_game draws each frame.
+ *
+ * draw_game used to call get_here for each of the 99 cells of the view, at
+ * the current and at the previous camera offset: 198 calls, each resolving
+ * the active map again. It now makes one map_get_rect call. Both are timed
+ * here, frame by frame, as the view walks back and forth across a map laid
+ * out like the overworld, held in RAM and then paged from a file. The overlay
+ * hash table lookups each makes per frame are counted by the map's table
+ * statistics (see print_map_stats).
+ *
+ * Usage: map_bench [frames]
+ */
+#include "globals.h"
+#include "graphics.h"
+#include "map.h"
+#include "world_fixture.h"
+
+#define BENCH_FILE "map_bench.map"
+
+/**
+ * Returns the overlay lookups the active map has made since the last call,
+ * from the statistics that print_map_stats prints (and then resets).
+ */
+static unsigned take_lookups()
+{
+    FILE* console = host_console;
+    host_console = tmpfile();
+    print_map_stats();
+    rewind(host_console);
+    char line[128];
+    unsigned lookups = 0;
+    while (fgets(line, sizeof(line), host_console))
+        sscanf(line, "Lookups: %u", &lookups);
+    fclose(host_console);
+    host_console = console;
+    return lookups;
+}
+
+/**
+ * The camera position for frame f: a walk to and fro along every row.
+ */
+static void camera(int f, int* x, int* y)
+{
+    int row = (f / 40) % 40;
+    int step = f % 40;
+    *x = 5 + ((row & 1) ? 39 - step : step);
+    *y = 5 + row;
+}
+
+/**
+ * Fetches the view for each of frames frames as draw_game did before: a
+ * get_here for every cell, at the camera and at the last camera.
+ */
+static void fetch_per_cell(int frames)
+{
+    MapItem* view[VIEW_W * VIEW_H];
+    MapItem* last[VIEW_W * VIEW_H];
+    int px = 0, py = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        int x, y;
+        camera(f, &x, &y);
+        for (int j = -4; j <= 4; j++)
+            for (int i = -5; i <= 5; i++)
+            {
+                view[(j + 4) * VIEW_W + i + 5] = get_here(x + i, y + j);
+                last[(j + 4) * VIEW_W + i + 5] = get_here(px + i, py + j);
+            }
+        px = x;
+        py = y;
+    }
+    // Keep the fetches from being optimized out
+    if (view[0] == (MapItem*) 1 || last[0] == (MapItem*) 1) printf("?");
+}
+
+/**
+ * Fetches the view for each of frames frames as draw_game does now.
+ */
+static void fetch_rect(int frames)
+{
+    MapItem* view[VIEW_W * VIEW_H];
+    for (int f = 0; f < frames; f++)
+    {
+        int x, y;
+        camera(f, &x, &y);
+        map_get_rect(x - 5, y - 4, VIEW_W, VIEW_H, view);
+    }
+    if (view[0] == (MapItem*) 1) printf("?");
+}
+
+static void run(const char* name, int frames)
+{
+    take_lookups();
+    double t0 = now_ns();
+    fetch_per_cell(frames);
+    double t1 = now_ns();
+    unsigned before = take_lookups();
+    fetch_rect(frames);
+    double t2 = now_ns();
+    unsigned after = take_lookups();
+
+    printf("%s, per frame:\n", name);
+    printf("  get_here x%d:  %5.1f overlay lookups, %7.1f ns\n", 2 * VIEW_W * VIEW_H,
+           (double) before / frames, (t1 - t0) / frames);
+    printf("  map_get_rect:  %5.1f overlay lookups, %7.1f ns\n",
+           (double) after / frames, (t2 - t1) / frames);
+}
+
+int main(int argc, char** argv)
+{
+    int frames = (argc > 1) ? atoi(argv[1]) : 20000;
+    host_console = NULL;
+    maps_init();
+
+    int m = map_create(50, 50);
+    set_active_map(m);
+    build_world();
+    run("50x50 map in RAM", frames);
+    map_destroy(m);
+
+    remove(BENCH_FILE);
+    m = map_create_paged(50, 50, BENCH_FILE);
+    if (m < 0)
+    {
+        printf("Could not make %s\n", BENCH_FILE);
+        return 1;
+    }
+    set_active_map(m);
+    build_world();
+    run("50x50 map paged from a file", frames);
+    map_destroy(m);
+    remove(BENCH_FILE);
+    return 0;
+}
@@ -0,0 +1,446 @@
+/**
+ * Behavioural tests for the map files of map.cpp.
+ *
+ * On the board a paged map's file is on the SD card, through SDFileSystem and
+ * stdio. Here the same stdio calls go to a file in the working directory, so
+ * what the map writes can be read back and checked. With 16 chunks to a 50x50
+ * map and 6 frames, going over the whole map pages every chunk in and out.
+ */
+#include "globals.h"
+#include "graphics.h"
+#include "map.h"
+#include "world_fixture.h"
+
+#define TEST_FILE "map_test.map"
+
+static int failures = 0;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+        failures++; \
+    } \
+} while (0)
+
+/**
+ * Plays the active map forward the way the game changes it: the door opens,
+ * the NPC walks, and some plants are trampled.
+ */
+static void play_world()
+{
+    MapItem* door = map_edit(25, 40);
+    door->draw = draw_door_open;
+    map_set_walkable(25, 40, true);
+    map_erase(24, 22);
+    add_NPC(30, 12, &world_npc_state);
+    for (int i = map_width() + 3; i < map_area(); i += 5 * 39)
+        map_erase(i % map_width(), i / map_width());
+}
+
+/**
+ * Checks that the w by h maps a and b hold the same items and walkability
+ * bitset.
+ */
+static void check_same(Map* a, Map* b, int w = 50, int h = 50)
+{
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            MapItem* p = map_get(a, x, y);
+            MapItem* q = map_get(b, x, y);
+            CHECK(!p == !q);
+            if (!p || !q) continue;
+            CHECK(p->type == q->type);
+            CHECK(p->walkable == q->walkable);
+            CHECK(p->draw == q->draw);
+            CHECK(p->data == q->data);
+        }
+    for (int y = 0; y < h; y++)
+        for (int i = 0; i < map_walk_stride(a); i++)
+            CHECK(map_walk_row(a, y)[i] == map_walk_row(b, y)[i]);
+}
+
+/**
+ * Returns the number of items of type type on the active map.
+ */
+static int count_type(int type)
+{
+    MapCell cells[8];
+    return map_find_in_rect(type, 0, 0, map_width(), map_height(), cells, 8);
+}
+
+/**
+ * A map paged through a file reads back just like one in RAM, before and after
+ * it is played, although every chunk has been paged out and in again.
+ */
+static void check_paged_matches_ram()
+{
+    maps_init();
+    remove(TEST_FILE);
+    int ram = map_create(50, 50);
+    int paged = map_create_paged(50, 50, TEST_FILE);
+    CHECK(paged >= 0);
+
+    set_active_map(ram);
+    build_world();
+    set_active_map(paged);
+    build_world();
+    check_same(get_map(ram), get_map(paged));
+
+    set_active_map(ram);
+    play_world();
+    set_active_map(paged);
+    play_world();
+    check_same(get_map(ram), get_map(paged));
+
+    // The NPC is the very item that was added, not a copy
+    CHECK(map_get(get_map(paged), 30, 12)->data == &world_npc_state);
+
+    map_destroy(ram);
+    map_destroy(paged);
+    printf("paged matches RAM: ok\n");
+}
+
+/**
+ * The file holds the tiles of the map, with the overlay items' tiles empty.
+ */
+static void check_file_contents()
+{
+    maps_init();
+    remove(TEST_FILE);
+    int m = map_create_paged(50, 50, TEST_FILE);
+    CHECK(m >= 0);
+    set_active_map(m);
+    add_NPC(3, 3, &world_npc_state);
+    build_world();
+    play_world();
+    MapItem* wall = map_edit(0, 10);
+    wall->draw = draw_plant;
+    map_sync();
+
+    FILE* f = fopen(TEST_FILE, "rb");
+    CHECK(f != NULL);
+    unsigned char header[8];
+    CHECK(fread(header, 1, sizeof(header), f) == sizeof(header));
+    unsigned char chunk[256];
+    int chunks = 0, overlays = 0, empty = 0;
+    while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk))
+    {
+        chunks++;
+        for (int i = 0; i < 256; i++)
+        {
+            if (chunk[i] == 0xFF) overlays++;
+            if (chunk[i] == 0) empty++;
+        }
+    }
+    fclose(f);
+    CHECK(chunks == 16);
+    CHECK(overlays == 0);
+    CHECK(empty > 0);
+
+    // And the items come back when their chunks are paged in again
+    CHECK(get_here(3, 3) && get_here(3, 3)->type == NPC);
+    CHECK(get_here(30, 12) && get_here(30, 12)->type == NPC);
+    CHECK(get_here(22, 26) && get_here(22, 26)->type == STAIRS);
+    CHECK(get_here(0, 10) && get_here(0, 10)->draw == draw_plant);
+    CHECK(!map_walkable(0, 10));
+    map_destroy(m);
+    printf("file contents: ok\n");
+}
+
+/**
+ * A file left from an earlier run, even of another size, is started over: the
+ * map is built afresh rather than on top of the old game state.
+ */
+static void check_old_file_ignored()
+{
+    // The earlier run, on a map of another size
+    maps_init();
+    remove(TEST_FILE);
+    int m = map_create_paged(60, 40, TEST_FILE);
+    CHECK(m >= 0);
+    set_active_map(m);
+    add_wall_rect(0, 0, 60, 40);
+    add_NPC(24, 22, &world_npc_state);
+    map_destroy(m);
+
+    // Then the same run twice, as after rebooting
+    for (int boot = 0; boot < 2; boot++)
+    {
+        maps_init();
+        int ram = map_create(50, 50);
+        set_active_map(ram);
+        build_world();
+        m = map_create_paged(50, 50, TEST_FILE);
+        CHECK(m >= 0);
+        set_active_map(m);
+        CHECK(map_width() == 50 && map_height() == 50);
+        CHECK(get_here(24, 22) == NULL);
+        build_world();
+        check_same(get_map(ram), get_map(m));
+        CHECK(count_type(NPC) == 1);
+        CHECK(count_type(STAIRS) == 1);
+        play_world();
+        map_destroy(m);
+        map_destroy(ram);
+    }
+    printf("old file ignored: ok\n");
+}
+
+/**
+ * An NPC's tile is clear in the walkability bitset, so map_walkable is the bit
+ * alone. Each step it takes flips two bits, which map_walk_changes reports,
+ * until there are more than the map remembers.
+ */
+static void check_npc_walk()
+{
+    maps_init();
+    int m = map_create(50, 50);
+    set_active_map(m);
+    build_world();
+    Map* mp = get_map(m);
+    MapCell flips[4];
+    unsigned start = map_walk_generation(mp);
+
+    for (int i = 0; i < 5; i++)
+    {
+        unsigned gen = map_walk_generation(mp);
+        map_erase(24 + i, 22);
+        add_NPC(25 + i, 22, &world_npc_state);
+        CHECK(!map_walkable(25 + i, 22));
+        CHECK(map_walkable(24 + i, 22));
+        int x = 25 + i;
+        CHECK(!(map_walk_row(mp, 22)[x >> 5] & (1u << (x & 31))));
+        CHECK(map_walk_generation(mp) != gen);
+        CHECK(map_walk_changes(mp, gen, flips, 4) == 2);
+        CHECK(flips[0].x == 24 + i && flips[0].y == 22 && flips[0].item == NULL);
+        CHECK(flips[1].x == 25 + i && flips[1].y == 22);
+    }
+
+    // So does the door opening, and nothing changes after that
+    unsigned gen = map_walk_generation(mp);
+    MapItem* door = map_edit(25, 40);
+    door->draw = draw_door_open;
+    map_set_walkable(25, 40, true);
+    CHECK(map_walkable(25, 40));
+    CHECK(!map_walkable(0, 0));
+    CHECK(map_walk_changes(mp, gen, flips, 4) == 1);
+    CHECK(flips[0].x == 25 && flips[0].y == 40);
+    CHECK(map_walk_changes(mp, map_walk_generation(mp), flips, 4) == 0);
+
+    // More flips than fit in out, or than the map keeps
+    CHECK(map_walk_changes(mp, start, flips, 4) == -1);
+    add_wall(1, 10, HORIZONTAL, 20);
+    CHECK(map_walk_changes(mp, gen, flips, 4) == -1);
+    map_destroy(m);
+    printf("NPC walk: ok\n");
+}
+
+/**
+ * map_find_nearest finds what a search of every tile finds, nearest by
+ * straight-line distance and the first in row-major order of those as near.
+ */
+static void check_find_nearest()
+{
+    maps_init();
+    int m = map_create(100, 100);
+    set_active_map(m);
+    MapCell cell;
+
+    // Nothing of the type, or a type the index does not hold
+    CHECK(!map_find_nearest(KEY, 50, 50, &cell));
+    add_wall(0, 0, HORIZONTAL, 100);
+    CHECK(!map_find_nearest(WALL, 50, 50, &cell));
+
+    // A tie between two cells: the cell of (20,20) holds (30,20), but (10,20)
+    // in the next one is as near and comes first
+    add_key(30, 20);
+    add_key(10, 20);
+    CHECK(map_find_nearest(KEY, 20, 20, &cell));
+    CHECK(cell.x == 10 && cell.y == 20 && cell.item && cell.item->type == KEY);
+
+    // The nearest is across a cell border, past one in the cell of (15,15)
+    add_key(1, 1);
+    add_key(17, 15);
+    CHECK(map_find_nearest(KEY, 15, 15, &cell));
+    CHECK(cell.x == 17 && cell.y == 15);
+
+    // Far across the map, many cells away, and from off the map
+    add_door(95, 90, false);
+    CHECK(map_find_nearest(DOOR, 2, 2, &cell));
+    CHECK(cell.x == 95 && cell.y == 90 && cell.item->type == DOOR);
+    CHECK(map_find_nearest(DOOR, -40, 300, &cell));
+    CHECK(cell.x == 95 && cell.y == 90);
+
+    // Against every tile, with keys scattered about
+    for (int i = 0; i < 60; i++)
+        add_key((i * 37 + 11) % 100, 1 + (i * 53 + 7) % 99);
+    for (int q = 0; q < 200; q++)
+    {
+        int x = (q * 29 + 3) % 110 - 5, y = (q * 71 + 13) % 110 - 5;
+        int bx = -1, by = -1;
+        unsigned best = 0xFFFFFFFF;
+        for (int ty = 0; ty < 100; ty++)
+            for (int tx = 0; tx < 100; tx++)
+            {
+                MapItem* item = get_here(tx, ty);
+                if (!item || item->type != KEY) continue;
+                unsigned d = (tx - x) * (tx - x) + (ty - y) * (ty - y);
+                if (d < best)
+                {
+                    best = d;
+                    bx = tx;
+                    by = ty;
+                }
+            }
+        CHECK(map_find_nearest(KEY, x, y, &cell));
+        CHECK(cell.x == bx && cell.y == by);
+    }
+    map_destroy(m);
+    printf("find nearest: ok\n");
+}
+
+/**
+ * A paged map has no tile grid in RAM: a 256x256 one takes well under a byte
+ * per tile, where the same map in RAM takes more than one. Its 256 chunks
+ * still read back as they were written, through 6 frames.
+ */
+static void check_paged_memory()
+{
+    maps_init();
+    remove(TEST_FILE);
+    int ram = map_create(256, 256);
+    int paged = map_create_paged(256, 256, TEST_FILE);
+    CHECK(ram >= 0 && paged >= 0);
+    CHECK(map_memory(get_map(ram)) > 256 * 256);
+    CHECK(map_memory(get_map(paged)) < 256 * 256 / 2);
+
+    int both[2] = { ram, paged };
+    for (int i = 0; i < 2; i++)
+    {
+        set_active_map(both[i]);
+        add_wall_rect(0, 0, 256, 256);
+        for (int i = 0; i < 256 * 256; i += 97)
+            add_plant(i % 256, i / 256);
+        add_NPC(200, 200, &world_npc_state);
+        add_door(100, 255, 0);
+    }
+    check_same(get_map(ram), get_map(paged), 256, 256);
+
+    // The file has every chunk, and the header
+    FILE* f = fopen(TEST_FILE, "rb");
+    CHECK(f != NULL);
+    fseek(f, 0, SEEK_END);
+    CHECK(ftell(f) == 8 + 256 * 256);
+    fclose(f);
+    map_destroy(ram);
+    map_destroy(paged);
+    printf("paged memory: ok\n");
+}
+
+/**
+ * Returns the peak arena use of the map print_memory_report lists first.
+ */
+static unsigned arena_peak()
+{
+    FILE* console = host_console;
+    host_console = tmpfile();
+    print_memory_report();
+    rewind(host_console);
+    char line[128];
+    unsigned peak = 0;
+    while (fgets(line, sizeof(line), host_console) && !peak)
+    {
+        const char* p = strstr(line, "peak ");
+        if (p && !strncmp(line, "Map", 3)) sscanf(p, "peak %u", &peak);
+    }
+    fclose(host_console);
+    host_console = console;
+    return peak;
+}
+
+/**
+ * The overlay table grows past its first buckets and shrinks back, over and
+ * over, as tiles are edited and erased. Each resize gives the old bucket array
+ * back, so the arena use does not creep up until the map runs out of memory.
+ */
+static void check_overlay_churn()
+{
+    maps_init();
+    int m = map_create(20, 20);
+    set_active_map(m);
+    unsigned peak = 0;
+    for (int round = 0; round < 50; round++)
+    {
+        add_wall(0, 0, HORIZONTAL, 20);
+        add_wall(0, 1, HORIZONTAL, 20);
+        // More items than the table's 8 buckets hold before it grows
+        for (int x = 0; x < 20; x++)
+        {
+            CHECK(map_edit(x, 0) != NULL);
+            CHECK(map_edit(x, 1) != NULL);
+        }
+        for (int x = 0; x < 20; x++)
+        {
+            map_erase(x, 0);
+            map_erase(x, 1);
+        }
+        if (round == 1) peak = arena_peak();
+    }
+    CHECK(arena_peak() == peak);
+    map_destroy(m);
+    printf("overlay churn: ok\n");
+}
+
+/**
+ * The second boot with a map file: the door was opened and the frames written
+ * back on the first, and the builder adds the door again over its tile.
+ */
+static void check_door_reboot()
+{
+    maps_init();
+    remove(TEST_FILE);
+    for (int boot = 0; boot < 2; boot++)
+    {
+        maps_init();
+        int m = map_create_paged(50, 50, TEST_FILE);
+        CHECK(m >= 0);
+        set_active_map(m);
+        build_world();
+        MapItem* door = get_here(25, 40);
+        CHECK(door && door->type == DOOR && !door->walkable);
+        CHECK(!map_walkable(25, 40));
+
+        door = map_edit(25, 40);
+        door->draw = draw_door_open;
+        map_set_walkable(25, 40, true);
+        // Evict every frame, the door's with it
+        for (int y = 0; y < 50; y += 16)
+            for (int x = 0; x < 50; x += 16)
+                get_here(x, y);
+        CHECK(map_walkable(25, 40));
+        map_destroy(m);
+    }
+    printf("door after reboot: ok\n");
+}
+
+int main()
+{
+    host_console = NULL;
+    check_paged_matches_ram();
+    check_file_contents();
+    check_old_file_ignored();
+    check_npc_walk();
+    check_find_nearest();
+    check_paged_memory();
+    check_overlay_churn();
+    check_door_reboot();
+    remove(TEST_FILE);
+
+    if (failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Host benchmark of the flow field search in path.cpp.
+ *
+ * path_build runs the search path_step runs whenever a cached field is stale,
+ * so its time is what a rebuild costs. It is timed here on a 50x50 grid (the
+ * size of the overworld) and on a 256x256 one, both open and with walls that
+ * make the paths wind back and forth.
+ *
+ * The second part plays the overworld forward: the NPC follows the player with
+ * path_step, moving every 5 frames as in the game. Each of its moves flips two
+ * tiles of the walkability bitset, and the frame after it used to pay for a
+ * rebuild of the field; now the field is repaired around the two tiles. The
+ * time per frame is shown against what a rebuild per move would add. The
+ * fields still built are the player's corner fields, after 80 moves out of
+ * use: more flips than the map remembers.
+ *
+ * Usage: path_bench [rounds]
+ */
+#include "globals.h"
+#include "map.h"
+#include "path.h"
+#include "world_fixture.h"
+
+/**
+ * Makes an all-walkable w by h bitset, laid out like the map's. If walls is
+ * set, every fourth row is a wall with one gap, at alternate ends.
+ */
+static unsigned* make_grid(int w, int h, int stride, int walls)
+{
+    unsigned* walk = (unsigned*) calloc(stride * h, sizeof(unsigned));
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            int wall = walls && y % 4 == 2 && x != ((y / 4) % 2 ? 0 : w - 1);
+            if (!wall) walk[y * stride + (x >> 5)] |= 1u << (x & 31);
+        }
+    return walk;
+}
+
+static void time_build(int w, int h, int walls, int rounds)
+{
+    int stride = (w + 31) >> 5;
+    unsigned* walk = make_grid(w, h, stride, walls);
+    int layers = 0;
+    double t0 = now_ns();
+    for (int i = 0; i < rounds; i++)
+        layers = path_build(walk, stride, w, h, 0, 0);
+    double t1 = now_ns();
+    printf("  %3dx%-3d %-6s %5d layers, %9.1f us per build\n", w, h, walls ? "walls" : "open",
+           layers, (t1 - t0) / rounds / 1000);
+    free(walk);
+}
+
+/**
+ * Moves the NPC after the player for frames frames on the active map, and
+ * returns the time per frame in ns. Counts the moves in moves.
+ */
+static double follow(int frames, int* moves)
+{
+    int dx[4] = { 0, 1, 0, -1 };
+    int dy[4] = { -1, 0, 1, 0 };
+    int x = 24, y = 22;
+    *moves = 0;
+
+    double t0 = now_ns();
+    for (int f = 0; f < frames; f++)
+    {
+        // The player waits in one corner and then the other, so the two cached
+        // fields cover it, and only the NPC could make them stale
+        int px = ((f / 400) % 2) ? 45 : 4;
+        int py = ((f / 400) % 2) ? 45 : 4;
+        int dir = path_step(px, py, x, y);
+        if (f % 5 || dir == PATH_NONE || (x + dx[dir] == px && y + dy[dir] == py)) continue;
+        map_erase(x, y);
+        x += dx[dir];
+        y += dy[dir];
+        add_NPC(x, y, &world_npc_state);
+        (*moves)++;
+    }
+    double t1 = now_ns();
+    map_erase(x, y);
+    return (t1 - t0) / frames;
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+    host_console = NULL;
+
+    printf("path_build:\n");
+    time_build(50, 50, false, rounds);
+    time_build(50, 50, true, rounds);
+    time_build(256, 256, false, rounds / 20 + 1);
+    time_build(256, 256, true, rounds / 20 + 1);
+
+    maps_init();
+    int m = map_create(50, 50);
+    set_active_map(m);
+    build_world();
+    unsigned built0, repaired0, built, repaired;
+    path_stats(&built0, &repaired0);
+    int frames = rounds * 10, moves;
+    double ns = follow(frames, &moves);
+    path_stats(&built, &repaired);
+
+    // What a rebuild of the overworld's field costs
+    double t0 = now_ns();
+    for (int i = 0; i < rounds; i++)
+        path_build(map_walk_row(get_map(m), 0), map_walk_stride(get_map(m)), 50, 50, 4, 4);
+    double build_ns = (now_ns() - t0) / rounds;
+
+    printf("NPC following the player on 50x50, %d moves in %d frames:\n", moves, frames);
+    printf("  %9.1f ns per frame, %u fields repaired, %u built\n", ns, repaired - repaired0,
+           built - built0);
+    printf("  %9.1f ns per frame more if each move cost a rebuild\n", build_ns * moves / frames);
+    map_destroy(m);
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * Behavioural tests for the flow fields of path.cpp.
+ *
+ * After every change to the map, each cached field is checked against a plain
+ * breadth-first search of the map: path_step gives PATH_NONE exactly for the
+ * tiles with no path, and for every other tile a step to a neighbour one
+ * closer to the target, which paths can go on through. Which of two equally
+ * short paths a field takes is left to it, so a repaired field need not match
+ * a freshly built one step for step, only be as short.
+ */
+#include "globals.h"
+#include "map.h"
+#include "path.h"
+#include "world_fixture.h"
+
+static int failures = 0;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+        failures++; \
+    } \
+} while (0)
+
+// Deterministic, so a failure can be replayed
+static unsigned rng = 1;
+static int random_below(int n)
+{
+    rng = rng * 1103515245u + 12345u;
+    return ((rng >> 8) & 0xFFFFFF) % n;
+}
+
+#define MAX_TILES (50 * 50)
+#define NO_PATH   -1
+
+static const int dx[4] = { 0, 1, 0, -1 };
+static const int dy[4] = { -1, 0, 1, 0 };
+
+/**
+ * Fills in dist with the distance of each tile of the active map to (tx,ty),
+ * or NO_PATH, by breadth-first search. Like a flow field, the target and the
+ * tiles next to a walkable reached tile are reached, walkable or not.
+ */
+static void reference(int tx, int ty, int* dist)
+{
+    static int queue[MAX_TILES];
+    int w = map_width(), h = map_height();
+    for (int i = 0; i < w * h; i++)
+        dist[i] = NO_PATH;
+    dist[ty * w + tx] = 0;
+    queue[0] = ty * w + tx;
+    for (int head = 0, tail = 1; head < tail; head++)
+    {
+        int x = queue[head] % w, y = queue[head] / w;
+        if (head > 0 && !map_walkable(x, y)) continue;
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int nx = x + dx[dir], ny = y + dy[dir];
+            if (nx < 0 || nx >= w || ny < 0 || ny >= h || dist[ny * w + nx] != NO_PATH) continue;
+            dist[ny * w + nx] = dist[queue[head]] + 1;
+            queue[tail++] = ny * w + nx;
+        }
+    }
+}
+
+/**
+ * Checks path_step toward (tx,ty) from every tile of the active map.
+ */
+static void check_field(int tx, int ty)
+{
+    static int dist[MAX_TILES];
+    reference(tx, ty, dist);
+    int w = map_width(), h = map_height();
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            int dir = path_step(tx, ty, x, y);
+            if (dist[y * w + x] <= 0)
+            {
+                CHECK(dir == PATH_NONE);
+                continue;
+            }
+            CHECK(dir >= PATH_NORTH && dir <= PATH_WEST);
+            if (dir < PATH_NORTH || dir > PATH_WEST) continue;
+            int nx = x + dx[dir], ny = y + dy[dir];
+            CHECK(nx >= 0 && nx < w && ny >= 0 && ny < h);
+            if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+            CHECK(dist[ny * w + nx] == dist[y * w + x] - 1);
+            CHECK((nx == tx && ny == ty) || map_walkable(nx, ny));
+        }
+}
+
+/**
+ * The NPC wanders the overworld while the player stands in one place and
+ * then another. Each of its steps is repaired in the cached field, never
+ * rebuilt, and every path stays as short as a fresh search makes it.
+ */
+static void check_npc_steps()
+{
+    maps_init();
+    int m = map_create(50, 50);
+    set_active_map(m);
+    build_world();
+    int x = 24, y = 22;
+    CHECK(!map_walkable(x, y));
+
+    rng = 1;
+    unsigned built0, repaired0, built, repaired;
+    path_stats(&built0, &repaired0);
+    for (int step = 0; step < 300; step++)
+    {
+        int px = (step < 150) ? 4 : 45;
+        int py = (step < 150) ? 4 : 45;
+        check_field(px, py);
+
+        // Toward the player, and now and then a random step
+        int dir = path_step(px, py, x, y);
+        if (dir == PATH_NONE || !random_below(3)) dir = random_below(4);
+        int nx = x + dx[dir], ny = y + dy[dir];
+        if (!map_walkable(nx, ny) || (nx == px && ny == py)) continue;
+        map_erase(x, y);
+        add_NPC(nx, ny, &world_npc_state);
+        x = nx;
+        y = ny;
+    }
+    path_stats(&built, &repaired);
+    // Once for each place the player stands
+    CHECK(built == built0 + 2);
+    CHECK(repaired > repaired0 + 50);
+    map_destroy(m);
+    printf("NPC steps: ok\n");
+}
+
+/**
+ * Random tiles of a maze of random walls flip, a few at a time, with two
+ * fields cached: one toward a tile that stays put, and one toward a tile that
+ * moves, and is sometimes a wall itself. Some flips close the only way into a
+ * part of the map, and some open one; some rounds flip more tiles than the
+ * map remembers, or more than a repair takes on, and the field is rebuilt.
+ */
+static void check_random_flips(unsigned seed, int rounds)
+{
+    maps_init();
+    int m = map_create(40, 30);
+    set_active_map(m);
+    rng = seed;
+    for (int i = 0; i < 40 * 30 / 3; i++)
+        add_wall(random_below(40), random_below(30), HORIZONTAL, 1);
+
+    int tx = 20, ty = 15;
+    map_erase(tx, ty);
+    unsigned built0, repaired0, built, repaired;
+    path_stats(&built0, &repaired0);
+    for (int round = 0; round < rounds; round++)
+    {
+        int n = random_below(10) ? 1 + random_below(3) : 1 + random_below(40);
+        for (int i = 0; i < n; i++)
+        {
+            int x = random_below(40), y = random_below(30);
+            if (map_walkable(x, y)) add_wall(x, y, HORIZONTAL, 1);
+            else map_erase(x, y);
+        }
+        if (!random_below(8))
+        {
+            tx = random_below(40);
+            ty = random_below(30);
+        }
+        check_field(20, 15);
+        check_field(tx, ty);
+    }
+    path_stats(&built, &repaired);
+    CHECK(repaired > repaired0);
+    CHECK(built > built0);
+    printf("seed %u: %u repairs, %u builds: ok\n", seed, repaired - repaired0, built - built0);
+    map_destroy(m);
+}
+
+/**
+ * A long wall flips more tiles than the map remembers, and a field is built
+ * again rather than repaired.
+ */
+static void check_big_change()
+{
+    maps_init();
+    int m = map_create(50, 50);
+    set_active_map(m);
+    build_world();
+    check_field(4, 4);
+    unsigned built0, repaired0, built, repaired;
+    path_stats(&built0, &repaired0);
+    add_wall(1, 10, HORIZONTAL, 40);
+    check_field(4, 4);
+    path_stats(&built, &repaired);
+    CHECK(built == built0 + 1);
+    CHECK(repaired == repaired0);
+    map_destroy(m);
+    printf("big change: ok\n");
+}
+
+int main()
+{
+    host_console = NULL;
+    check_npc_steps();
+    check_random_flips(1, 300);
+    check_random_flips(2, 300);
+    check_random_flips(3, 300);
+    check_big_change();
+
+    if (failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+// Host stand-in for the accelerometer library
+#ifndef MMA8452_H
+#define MMA8452_H
+
+class MMA8452 {
+public:
+    MMA8452(PinName sda, PinName scl, int frequency) {}
+};
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * Host stand-in for mbed's RawSerial, on the simulated LCD UART in
+ * sim_uart.cpp. Whatever the pins, it is that UART.
+ */
+#ifndef RAWSERIAL_H
+#define RAWSERIAL_H
+
+#include "mbed.h"
+#include "sim_uart.h"
+
+class RawSerial {
+public:
+    enum IrqType { RxIrq = 0, TxIrq };
+
+    RawSerial(PinName tx, PinName rx) {}
+    void baud(int rate) {}
+    int writeable() { return sim_uart_writeable(); }
+    int readable() { return sim_uart_readable(); }
+    int putc(int c) { sim_uart_putc(c); return c; }
+    int getc() { return sim_uart_getc(); }
+    void attach(void (*handler)(), IrqType type = RxIrq) { sim_uart_attach(handler, type == TxIrq); }
+};
+
+#endif // RAWSERIAL_H
@@ -0,0 +1,11 @@
+// Host stand-in for the SD card library: on the host, map files are ordinary
+// files, standing in for the card
+#ifndef SDFILESYSTEM_H
+#define SDFILESYSTEM_H
+
+class SDFileSystem {
+public:
+    SDFileSystem(PinName mosi, PinName miso, PinName sck, PinName cs, const char* name) {}
+};
+
+#endif
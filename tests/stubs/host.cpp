@@ -0,0 +1,19 @@
+/**
+ * The globals that the game's modules expect from hardware.cpp and
+ * graphics.cpp, for host builds that leave those out. Nothing is drawn.
+ */
+#include "globals.h"
+#include "graphics.h"
+
+FILE* host_console = stdout;
+Serial pc(USBTX, USBRX);
+
+void draw_nothing(int u, int v) {}
+void draw_wall(int u, int v) {}
+void draw_plant(int u, int v) {}
+void draw_NPC(int u, int v) {}
+void draw_key(int u, int v) {}
+void draw_door_open(int u, int v) {}
+void draw_door_closed(int u, int v) {}
+void draw_stairs(int u, int v) {}
+void draw_win_item(int u, int v) {}
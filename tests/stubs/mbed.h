@@ -0,0 +1,94 @@
+/**
+ * Host stand-in for the parts of the mbed library that the game's modules
+ * use, so that they build and run off the board for the tests. Only what the
+ * tests link against is here.
+ */
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum PinName {
+    p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19,
+    p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30, USBTX, USBRX, NC
+};
+enum PinMode { PullUp, PullDown, PullNone };
+
+/**
+ * Where Serial output goes. Set it to NULL to drop the output.
+ */
+extern FILE* host_console;
+
+class Serial {
+public:
+    Serial(PinName tx, PinName rx) {}
+    void baud(int rate) {}
+    int printf(const char* format, ...)
+    {
+        if (!host_console) return 0;
+        va_list args;
+        va_start(args, format);
+        int n = vfprintf(host_console, format, args);
+        va_end(args);
+        return n;
+    }
+};
+
+/**
+ * Wall clock time, as the board's timer would give it.
+ */
+class Timer {
+public:
+    Timer() : started(0), total(0), running(false) {}
+    void start() { started = now_us(); running = true; }
+    void stop() { total += now_us() - started; running = false; }
+    void reset() { total = 0; started = now_us(); }
+    int read_us() { return (int) (total + (running ? now_us() - started : 0)); }
+    int read_ms() { return read_us() / 1000; }
+private:
+    static long long now_us()
+    {
+        timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+    }
+    long long started, total;
+    bool running;
+};
+
+inline void wait_ms(int ms)
+{
+    timespec t = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&t, NULL);
+}
+
+class DigitalIn {
+public:
+    DigitalIn(PinName pin) {}
+    void mode(PinMode mode) {}
+    int read() { return 1; }
+};
+
+class AnalogOut {
+public:
+    AnalogOut(PinName pin) {}
+};
+
+class PwmOut {
+public:
+    PwmOut(PinName pin) {}
+};
+
+/**
+ * Interrupt control. Only the simulated LCD UART has interrupts, so these are
+ * in sim_uart.cpp, and only programs linked with it can use them.
+ */
+void __disable_irq();
+void __enable_irq();
+void __WFI();
+
+#endif // MBED_H
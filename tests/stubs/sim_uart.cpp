@@ -0,0 +1,218 @@
+/**
+ * The simulated LCD UART described in sim_uart.h, and the interrupt control
+ * functions of mbed.h that go with it.
+ */
+#include "sim_uart.h"
+
+#include "mbed.h"
+
+#include <deque>
+
+// Commands of the LCD's serial protocol that lcd.cpp sends
+#define CMD_BLIT        0x000A
+#define CMD_FILLED_RECT 0xFFCE
+#define ACK             0x06
+
+// Ticks to give up after, when waiting for something that never comes
+#define STUCK_TICKS 10000000
+
+int sim_uart_fifo = 16;
+int sim_uart_ack_delay = 8;
+int sim_uart_preempt = 0;
+std::vector<std::vector<unsigned char> > sim_uart_commands;
+long sim_uart_bytes = 0;
+long sim_uart_interrupts = 0;
+
+static void (*tx_handler)() = NULL;
+static void (*rx_handler)() = NULL;
+static bool tx_enabled = false;
+static bool rx_enabled = false;
+static bool masked = false;      // Between __disable_irq and __enable_irq
+static bool in_handler = false;
+
+static std::deque<unsigned char> tx_fifo;
+static std::deque<unsigned char> rx_fifo;
+static std::vector<unsigned char> command; // What the LCD has of the next command
+static std::deque<long> acks;              // When each reply is due
+static long now = 0;
+
+// The simulator's own random numbers, so that it leaves rand() to the test
+static unsigned seed = 12345;
+static int random_below(int n)
+{
+    seed = seed * 1103515245u + 12345u;
+    return ((seed >> 16) & 0x7FFF) % n;
+}
+
+static void fail(const char* what)
+{
+    fprintf(stderr, "sim_uart: %s\n", what);
+    abort();
+}
+
+/**
+ * Returns the length of the command the LCD is receiving, or 0 if it has not
+ * received enough of it to tell.
+ */
+static unsigned command_length()
+{
+    if (command.size() < 2) return 0;
+    int op = (command[0] << 8) | command[1];
+    if (op == CMD_FILLED_RECT) return 12;
+    if (op != CMD_BLIT) fail("unknown command");
+    if (command.size() < 10) return 0;
+    int w = (command[6] << 8) | command[7];
+    int h = (command[8] << 8) | command[9];
+    return 10 + 2 * w * h;
+}
+
+/**
+ * The LCD receives a byte, and replies once it has a whole command.
+ */
+static void receive(unsigned char byte)
+{
+    if (!acks.empty()) fail("byte sent before the LCD replied to the last command");
+    command.push_back(byte);
+    sim_uart_bytes++;
+    if (command.size() == command_length())
+    {
+        sim_uart_commands.push_back(command);
+        command.clear();
+        acks.push_back(now + sim_uart_ack_delay);
+    }
+}
+
+/**
+ * One tick: a byte goes out, and any reply that is due comes back.
+ */
+static void tick()
+{
+    now++;
+    if (!tx_fifo.empty())
+    {
+        receive(tx_fifo.front());
+        tx_fifo.pop_front();
+    }
+    while (!acks.empty() && acks.front() <= now)
+    {
+        rx_fifo.push_back(ACK);
+        acks.pop_front();
+    }
+}
+
+static bool rx_pending()
+{
+    return rx_enabled && !rx_fifo.empty();
+}
+
+static bool tx_pending()
+{
+    return tx_enabled && tx_fifo.empty();
+}
+
+/**
+ * Returns true if anything is still on its way in either direction.
+ */
+static bool busy()
+{
+    return !tx_fifo.empty() || !rx_fifo.empty() || !command.empty() || !acks.empty();
+}
+
+/**
+ * Runs the handlers of the pending interrupts, unless interrupts are off or
+ * one is already running.
+ */
+static void service()
+{
+    if (masked || in_handler) return;
+    in_handler = true;
+    while (rx_pending() || tx_pending())
+    {
+        sim_uart_interrupts++;
+        if (rx_pending())
+        {
+            rx_handler();
+        }
+        else
+        {
+            tx_handler();
+            if (tx_pending()) fail("transmit interrupt left on with nothing to send");
+        }
+    }
+    in_handler = false;
+}
+
+bool sim_uart_idle()
+{
+    return !tx_enabled && !rx_enabled && !busy();
+}
+
+void sim_uart_attach(void (*handler)(), int tx)
+{
+    if (tx)
+    {
+        if (handler) tx_handler = handler;
+        tx_enabled = handler != NULL;
+    }
+    else
+    {
+        if (handler) rx_handler = handler;
+        rx_enabled = handler != NULL;
+    }
+    service();
+}
+
+int sim_uart_writeable()
+{
+    return (int) tx_fifo.size() < sim_uart_fifo;
+}
+
+int sim_uart_readable()
+{
+    return !rx_fifo.empty();
+}
+
+void sim_uart_putc(int c)
+{
+    if (!sim_uart_writeable()) fail("write to a full transmit FIFO");
+    tx_fifo.push_back(c);
+}
+
+int sim_uart_getc()
+{
+    if (rx_fifo.empty()) fail("read from an empty receive FIFO");
+    int c = rx_fifo.front();
+    rx_fifo.pop_front();
+    return c;
+}
+
+void __disable_irq()
+{
+    masked = true;
+}
+
+void __enable_irq()
+{
+    masked = false;
+    // Now and then the main code runs for a while before the next call
+    if (sim_uart_preempt && random_below(100) < sim_uart_preempt)
+    {
+        for (int n = random_below(40); n > 0; n--)
+        {
+            tick();
+            service();
+        }
+    }
+    service();
+}
+
+void __WFI()
+{
+    if (in_handler) fail("__WFI in an interrupt handler");
+    for (long n = 0; !rx_pending() && !tx_pending(); n++)
+    {
+        if (!busy() || n > STUCK_TICKS) fail("__WFI with no interrupt to wake it");
+        tick();
+    }
+    service();
+}
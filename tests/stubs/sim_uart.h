@@ -0,0 +1,53 @@
+#ifndef SIM_UART_H
+#define SIM_UART_H
+
+/**
+ * A simulated LCD UART, for testing lcd.cpp off the board.
+ *
+ * Time goes in ticks, and each tick the UART sends one byte from its transmit
+ * FIFO to a simulated LCD. The LCD decodes the serial protocol and replies to
+ * each whole command with an ACK, sim_uart_ack_delay ticks later. Like the real
+ * one, it would lose bytes that arrive before it has replied, so the simulator
+ * fails the test if that happens.
+ *
+ * The interrupts are the UART's: the receive interrupt is pending while there
+ * is a reply to read, and the transmit interrupt while the FIFO is empty. They
+ * run when interrupts are enabled (see __enable_irq in mbed.h), and
+ * __WFI lets time pass until one is pending. Any misuse of the UART (writing to
+ * a full FIFO, reading an empty one, an interrupt that never clears, sleeping
+ * with nothing to wake up for) is reported and aborts the test.
+ */
+
+#include <vector>
+
+// Bytes the transmit FIFO holds, 16 as on the LPC1768
+extern int sim_uart_fifo;
+
+// Ticks from the end of a command to the LCD's ACK
+extern int sim_uart_ack_delay;
+
+// Percentage of __enable_irq calls at which a random number of ticks passes,
+// as if the main code had been running that long
+extern int sim_uart_preempt;
+
+// The commands the LCD has received, each as its bytes
+extern std::vector<std::vector<unsigned char> > sim_uart_commands;
+
+// Bytes sent and interrupt handler calls
+extern long sim_uart_bytes;
+extern long sim_uart_interrupts;
+
+/**
+ * Returns true if the UART is quiet: no interrupt is enabled, and nothing is
+ * in the FIFOs or waiting for a reply. uLCD may only use the UART then.
+ */
+bool sim_uart_idle();
+
+// Called by the RawSerial stand-in, see RawSerial.h
+void sim_uart_attach(void (*handler)(), int tx);
+int sim_uart_writeable();
+int sim_uart_readable();
+void sim_uart_putc(int c);
+int sim_uart_getc();
+
+#endif // SIM_UART_H
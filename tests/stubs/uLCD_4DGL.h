@@ -0,0 +1,26 @@
+// Host stand-in for the uLCD library. Nothing is drawn; the colours and fonts
+// are the library's, so that graphics.cpp builds for the draw benchmark
+#ifndef ULCD_4DGL_H
+#define ULCD_4DGL_H
+
+#define BLACK 0x000000
+#define WHITE 0xFFFFFF
+#define RED   0xFF0000
+#define GREEN 0x00FF00
+#define BLUE  0x0000FF
+#define LGREY 0xBFBFBF
+#define DGREY 0x5F5F5F
+
+#define FONT_5X7   0
+#define FONT_12X16 3
+
+class uLCD_4DGL {
+public:
+    uLCD_4DGL(PinName tx, PinName rx, PinName reset) {}
+    void line(int x1, int y1, int x2, int y2, int color) {}
+    void filled_rectangle(int x1, int y1, int x2, int y2, int color) {}
+    void filled_circle(int x, int y, int radius, int color) {}
+    void text_string(const char* s, char col, char row, char font, int color) {}
+};
+
+#endif
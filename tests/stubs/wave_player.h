@@ -0,0 +1,10 @@
+// Host stand-in for the wave player library
+#ifndef WAVE_PLAYER_H
+#define WAVE_PLAYER_H
+
+class wave_player {
+public:
+    wave_player(AnalogOut* dac) {}
+};
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * The overworld of world_fixture.h, copied from build_main_map in main.cpp.
+ */
+#include "world_fixture.h"
+
+#include "map.h"
+
+int world_npc_state = 1;
+int world_stairs_to = 1;
+
+void build_world()
+{
+    // Plants, except in the throne building
+    for (int i = map_width() + 3; i < map_area(); i += 39)
+    {
+        int x = i % map_width();
+        int y = i / map_width();
+        if (!(x > 16 && x < 35 && y > 27 && y < 40))
+            add_plant(x, y);
+    }
+
+    add_wall_rect(0, 0, map_width(), map_height());
+    // Player building
+    add_wall(23, 23, HORIZONTAL, 2);
+    add_wall(23, 24, VERTICAL, 4);
+    add_wall(26, 23, HORIZONTAL, 2);
+    add_wall(27, 24, VERTICAL, 4);
+    add_wall(24, 27, HORIZONTAL, 3);
+    // Throne building
+    add_wall(16, 27, HORIZONTAL, 7);
+    add_wall(28, 27, HORIZONTAL, 7);
+    add_wall(16, 28, VERTICAL, 12);
+    add_wall(35, 27, VERTICAL, 13);
+    add_wall(16, 40, HORIZONTAL, 20);
+
+    add_NPC(24, 22, &world_npc_state);
+    add_door(25, 40, 0);
+    add_win_item(25, 33);
+    add_stairs(22, 26, &world_stairs_to);
+}
@@ -0,0 +1,32 @@
+/**
+ * What the host tests and benchmarks of the map share: the overworld, and a
+ * clock to time things with.
+ */
+#ifndef WORLD_FIXTURE_H
+#define WORLD_FIXTURE_H
+
+#include <time.h>
+
+// The data of the overworld's NPC and stairs: the NPC's state, and the map
+// the stairs lead to
+extern int world_npc_state;
+extern int world_stairs_to;
+
+/**
+ * Lays out the active map like the overworld, as all of build_main_map's
+ * steps do: plants, the border, the player's and the throne buildings, and
+ * the NPC, door, throne and stairs. Keep it in step with build_main_map.
+ */
+void build_world();
+
+/**
+ * Returns the time on the monotonic clock, in ns.
+ */
+static inline double now_ns()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+#endif // WORLD_FIXTURE_H